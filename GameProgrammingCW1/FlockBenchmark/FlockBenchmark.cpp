@@ -0,0 +1,915 @@
+// Headless flocking benchmark, no window or GL context needed.
+// Compares the previous three-pass implementation (BoidRule1/2/3 from
+// Source.cpp), the fused single-pass FlockRules over Body and the SoA Flock
+// (radius and k-nearest neighbours) on the same starting flock.
+// A step is the rules, integration and boid / obstacle collision.
+//
+// The stress run steps 1k, 10k and 100k boid SoA flocks for a fixed number of
+// ticks with 1 thread up to every hardware thread and reports ns per
+// boid-tick, the thread scaling and how many neighbours the boids see.
+//
+// The physics run integrates the same bodies with Body::Update one at a time
+// and with the batched PhysicsWorld::Step, then times a crowd where 9 in 10
+// bodies are idle and fall asleep.
+//
+// The raycast run casts batches of random rays against the obstacle grid one
+// ray at a time, four at a time in SSE lanes and on every hardware thread.
+//
+// The broadphase run moves boxes among as many static ones and checks the
+// sweep-and-prune CollisionWorld and the AabbTree pairs, AabbTree box queries
+// and ray casts against brute force.
+//
+// The particles run steps ParticleStore emitters of up to 1M particles with
+// lifetimes spread so a few die every step, then times filling the random
+// velocities of a burst against a memset of the same arrays, and the radix
+// depth sort against std::sort on the same view depths, and how many frames
+// of a ParticleSystem-like emitter actually need a new sort.
+//
+// usage: FlockBenchmark [compare | stress | physics | raycast | broadphase | particles]   (all by default)
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+using namespace std;
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Body.h"
+#include "SpatialGrid.h"
+#include "FlockRules.h"
+#include "Flock.h"
+#include "SimdFloat.h"
+#include "ThreadPool.h"
+#include "PhysicsWorld.h"
+#include "GridRaycaster.h"
+#include "CollisionWorld.h"
+#include "AabbTree.h"
+#include "ParticleStore.h"
+#include "Random.h"
+#include "DepthSorter.h"
+
+const int TICKS = 100;
+const int STRESS_TICKS = 50;
+const float DELTA = 1.0f / 60.0f;
+
+glm::vec3 target(210.0f, 1.5f, 204.0f);
+
+#pragma region THREE PASS (REFERENCE)
+
+SpatialGrid referenceGrid(1.0f);
+std::vector<float> referenceX, referenceY, referenceZ;
+
+glm::vec3 GetBoidsCenter(std::vector<Body>& boids)
+{
+	glm::vec3 temp = glm::vec3(0, 0, 0);
+	for (int i = 0; i < boids.size(); i++)
+	{
+		temp += boids[i].position;
+	}
+	return temp / (float)boids.size();
+}
+
+void BoidRule1(std::vector<Body>& boids)
+{
+	for (int i = 0; i < boids.size(); i++)
+	{
+		boids[i].boidVelocity += (GetBoidsCenter(boids) - boids[i].position) / glm::vec3(100, 100, 100);
+		boids[i].boidVelocity += (target - boids[i].position) / glm::vec3(8, 8, 8);
+	}
+}
+
+void BoidRule2(std::vector<Body>& boids, std::vector<Body>& obstacles)
+{
+	referenceX.resize(boids.size());
+	referenceY.resize(boids.size());
+	referenceZ.resize(boids.size());
+	for (int i = 0; i < boids.size(); i++)
+	{
+		referenceX[i] = boids[i].position.x;
+		referenceY[i] = boids[i].position.y;
+		referenceZ[i] = boids[i].position.z;
+	}
+	referenceGrid.Build(&referenceX[0], &referenceY[0], &referenceZ[0], boids.size());
+
+	for (int i = 0; i < boids.size(); i++)
+	{
+		if (boids[i].position.y < 1)
+		{
+			boids[i].boidVelocity += 1;
+		}
+
+		glm::vec3 position = boids[i].position;
+		referenceGrid.ForEachNeighbour(position, [&](unsigned int j)
+		{
+			if ((unsigned int)i != j && glm::distance(position, boids[j].position) < 1)
+			{
+				boids[i].boidVelocity += position - boids[j].position;
+			}
+		});
+
+		for (int j = 0; j < obstacles.size(); j++)
+		{
+			if (glm::distance(boids[i].position, obstacles[j].position) < 1.2f)
+			{
+				boids[i].boidVelocity += boids[i].position - obstacles[j].position;
+			}
+		}
+	}
+}
+
+void BoidRule3(std::vector<Body>& boids)
+{
+	glm::vec3 tempVel = glm::vec3(0, 0, 0);
+	for (int i = 0; i < boids.size(); i++)
+	{
+		for (int j = 0; j < boids.size(); j++)
+		{
+			tempVel += boids[j].velocity;
+		}
+		tempVel = tempVel / (float)boids.size();
+		boids[i].boidVelocity += tempVel / glm::vec3(8, 8, 8);
+	}
+}
+
+#pragma endregion
+
+std::vector<Body> CreateFlock(int count)
+{
+	srand(0);
+	std::vector<Body> boids;
+	for (int i = 0; i < count; i++)
+	{
+		Body body(glm::vec3(200.0f + rand() % 10 + 1, 0.5f, 200.0f + rand() % 10 + 1), glm::vec3(0.0f), glm::vec3(1.0f));
+		body.isBoid = true;
+		body.topSpeed = 0.2f;
+		boids.push_back(body);
+	}
+	return boids;
+}
+
+glm::vec3 obstaclesOffset(200.0f, 0.0f, 200.0f);
+
+// a wall across the middle of the boids scene
+std::vector<std::vector<int>> CreateObstaclesGrid()
+{
+	std::vector<std::vector<int>> grid(12, std::vector<int>(12, 0));
+	for (int j = 0; j < 12; j++)
+	{
+		grid[5][j] = 1;
+	}
+	return grid;
+}
+
+// one static Body per wall cell, as built in Source.cpp
+std::vector<Body> CreateObstacles(const std::vector<std::vector<int>>& grid)
+{
+	std::vector<Body> obstacles;
+	for (int i = 0; i < grid.size(); i++)
+	{
+		for (int j = 0; j < grid[i].size(); j++)
+		{
+			if (grid[i][j] == 1)
+			{
+				Body body(glm::vec3(j + obstaclesOffset.x, 0.5f, i + obstaclesOffset.z), glm::vec3(0.0f), glm::vec3(1.0f));
+				body.isStatic = true;
+				obstacles.push_back(body);
+			}
+		}
+	}
+	return obstacles;
+}
+
+void Integrate(std::vector<Body>& boids)
+{
+	for (int i = 0; i < boids.size(); i++)
+	{
+		boids[i].velocity += boids[i].boidVelocity;
+		boids[i].Update(DELTA);
+		boids[i].boidVelocity = glm::vec3(0, 0, 0);
+	}
+}
+
+void CollideObstacles(std::vector<Body>& boids, std::vector<Body>& obstacles)
+{
+	// boid branch of CheckCollision in Source.cpp
+	for (int i = 0; i < boids.size(); i++)
+	{
+		Body& boid = boids[i];
+		boid.left = boid.position.x - boid.scale.x / 2;
+		boid.right = boid.position.x + boid.scale.x / 2;
+		boid.down = boid.position.z - boid.scale.z / 2;
+		boid.up = boid.position.z + boid.scale.z / 2;
+		for (int j = 0; j < obstacles.size(); j++)
+		{
+			Body& obstacle = obstacles[j];
+			if (boid.left < obstacle.right && boid.right > obstacle.left && boid.up > obstacle.down && boid.down < obstacle.up)
+			{
+				boid.isColliding = true;
+				boid.addedForce = boid.velocity * glm::vec3(1.5f, 1.5f, 1.5f);
+			}
+			else
+			{
+				boid.isColliding = false;
+			}
+		}
+	}
+}
+
+// milliseconds per tick
+template<typename Step>
+double TimeTicks(Step step, int ticks = TICKS)
+{
+	auto start = chrono::high_resolution_clock::now();
+	for (int t = 0; t < ticks; t++)
+	{
+		step();
+	}
+	auto end = chrono::high_resolution_clock::now();
+	return chrono::duration<double, std::milli>(end - start).count() / ticks;
+}
+
+#pragma region STRESS
+
+// boids spread over an area that grows with the count, about as dense as the
+// boids scene when it starts
+void FillStressFlock(Flock& flock, int count)
+{
+	srand(0);
+	float side = std::sqrt(count / 2.0f);
+	for (int i = 0; i < count; i++)
+	{
+		float x = (float)rand() / RAND_MAX * side;
+		float z = (float)rand() / RAND_MAX * side;
+		flock.Add(glm::vec3(obstaclesOffset.x + x, 0.5f, obstaclesOffset.z + z));
+	}
+}
+
+// boids within the separation radius of every boid, itself excluded
+void CountNeighbours(const Flock& flock, double& average, unsigned int& maximum)
+{
+	const FlockState& state = flock.State();
+	SpatialGrid grid(flock.params.separationRadius);
+	grid.Build(&state.positionX[0], &state.positionY[0], &state.positionZ[0], flock.Size());
+
+	float radius2 = flock.params.separationRadius * flock.params.separationRadius;
+	unsigned long long total = 0;
+	maximum = 0;
+	for (unsigned int i = 0; i < flock.Size(); i++)
+	{
+		glm::vec3 position = flock.Position(i);
+		unsigned int neighbours = 0;
+		grid.ForEachNeighbour(position, [&](unsigned int j)
+		{
+			glm::vec3 offset = position - flock.Position(j);
+			if (i != j && glm::dot(offset, offset) < radius2)
+				neighbours++;
+		});
+		total += neighbours;
+		maximum = std::max(maximum, neighbours);
+	}
+	average = (double)total / flock.Size();
+}
+
+void RunStress(const DistanceField& obstacleField)
+{
+	int counts[] = { 1000, 10000, 100000 };
+
+	unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(hardwareThreads);
+
+	cout << endl << "STRESS (" << STRESS_TICKS << " ticks, " << hardwareThreads << " hardware threads)" << endl;
+	cout << "boids\tthreads\tms/tick\tns/boid-tick\tscaling\tneighbours avg\tneighbours max" << endl;
+	for (int count : counts)
+	{
+		double singleThreadTime = 0.0;
+		for (unsigned int threads : threadCounts)
+		{
+			ThreadPool pool(threads - 1);
+			Flock flock;
+			flock.topSpeed = 0.2f;
+			flock.SetObstacleField(&obstacleField);
+			flock.SetThreadPool(&pool);
+			FillStressFlock(flock, count);
+
+			double time = TimeTicks([&]()
+			{
+				flock.Step(target, DELTA);
+			}, STRESS_TICKS);
+			if (threads == 1)
+			{
+				singleThreadTime = time;
+			}
+
+			double average;
+			unsigned int maximum;
+			CountNeighbours(flock, average, maximum);
+
+			cout << count << "\t" << threads << "\t" << time << "\t" << time * 1e6 / count << "\t\t"
+				<< singleThreadTime / time << "x\t" << average << "\t\t" << maximum << endl;
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region PHYSICS
+
+void RunPhysics()
+{
+	int counts[] = { 1000, 10000, 100000 };
+
+	cout << endl << "PHYSICS (" << TICKS << " ticks)" << endl;
+	cout << "bodies\tBody::Update ms\tPhysicsWorld ms\tspeedup\tmax position difference\tidle crowd ms" << endl;
+	for (int count : counts)
+	{
+		// boids so Body::Update does not print its direction
+		srand(0);
+		std::vector<Body> bodies;
+		PhysicsWorld world;
+		for (int i = 0; i < count; i++)
+		{
+			Body body(glm::vec3(rand() % 100, 0.5f, rand() % 100), glm::vec3(0.0f), glm::vec3(1.0f));
+			body.isBoid = true;
+			body.isStatic = i % 10 == 0;
+			body.acceleration = glm::vec3(rand() % 21 - 10, 0.0f, rand() % 21 - 10) * 0.01f;
+			bodies.push_back(body);
+			world.Add(body);
+		}
+
+		double bodyTime = TimeTicks([&]()
+		{
+			for (Body& body : bodies)
+			{
+				body.Update(DELTA);
+			}
+		});
+		double worldTime = TimeTicks([&]()
+		{
+			world.Step(DELTA);
+		});
+
+		float difference = 0.0f;
+		for (int i = 0; i < count; i++)
+		{
+			difference = std::max(difference, glm::length(bodies[i].position - world.Position(i)));
+		}
+
+		// the moving tenth kept together so most blocks are asleep
+		PhysicsWorld crowd;
+		for (int i = 0; i < count; i++)
+		{
+			Body body = bodies[i];
+			body.velocity = glm::vec3(0.0f);
+			body.acceleration = i < count / 10 ? glm::vec3(0.01f, 0.0f, 0.0f) : glm::vec3(0.0f);
+			crowd.Add(body);
+		}
+		for (float time = 0.0f; time <= crowd.sleepTime; time += DELTA)
+		{
+			crowd.Step(DELTA);
+		}
+		double crowdTime = TimeTicks([&]()
+		{
+			crowd.Step(DELTA);
+		});
+
+		cout << count << "\t" << bodyTime << "\t\t" << worldTime << "\t\t" << bodyTime / worldTime << "x\t" << difference << "\t\t\t" << crowdTime << endl;
+	}
+}
+
+#pragma endregion
+
+#pragma region RAYCAST
+
+void RunRaycast(const std::vector<std::vector<int>>& obstaclesGrid)
+{
+	int counts[] = { 1000, 10000, 100000 };
+
+	TileMap tiles;
+	tiles.Load(obstaclesGrid, obstaclesOffset);
+	GridRaycaster raycaster;
+	raycaster.SetTiles(&tiles);
+	ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+
+	cout << endl << "RAYCAST (" << TICKS << " batches)" << endl;
+	cout << "rays	one at a time ms	four at a time ms	threaded ms	hits" << endl;
+	for (int count : counts)
+	{
+		srand(0);
+		RayBatch rays;
+		for (int i = 0; i < count; i++)
+		{
+			float angle = (rand() % 6283) * 0.001f;
+			glm::vec3 origin(obstaclesOffset.x - 2.0f + (rand() % 1600) * 0.01f, 0.5f, obstaclesOffset.z - 2.0f + (rand() % 1600) * 0.01f);
+			rays.Add(origin, glm::vec3(std::cos(angle), 0.0f, std::sin(angle)), 16.0f);
+		}
+
+		RayHits hits;
+		raycaster.useSimd = false;
+		double scalarTime = TimeTicks([&]()
+		{
+			raycaster.Cast(rays, hits);
+		});
+		raycaster.useSimd = true;
+		double simdTime = TimeTicks([&]()
+		{
+			raycaster.Cast(rays, hits);
+		});
+		raycaster.SetThreadPool(&pool);
+		double threadedTime = TimeTicks([&]()
+		{
+			raycaster.Cast(rays, hits);
+		});
+		raycaster.SetThreadPool(nullptr);
+
+		int hitCount = 0;
+		for (unsigned int i = 0; i < hits.Size(); i++)
+		{
+			hitCount += hits.Hit(i) ? 1 : 0;
+		}
+
+		cout << count << "\t" << scalarTime << "\t\t" << simdTime << "\t\t" << threadedTime << "\t\t" << hitCount << endl;
+	}
+}
+
+#pragma endregion
+
+#pragma region BROADPHASE
+
+// fraction along the segment where it enters the box, slab test
+bool SegmentEntry(const Aabb& box, glm::vec3 start, glm::vec3 end, float& fraction)
+{
+	float tMin = 0.0f, tMax = 1.0f;
+	float origin[2] = { start.x, start.z };
+	float direction[2] = { end.x - start.x, end.z - start.z };
+	float low[2] = { box.left, box.down };
+	float high[2] = { box.right, box.up };
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (std::fabs(direction[axis]) < 1e-8f)
+		{
+			if (origin[axis] < low[axis] || origin[axis] > high[axis])
+				return false;
+			continue;
+		}
+		float t1 = (low[axis] - origin[axis]) / direction[axis];
+		float t2 = (high[axis] - origin[axis]) / direction[axis];
+		tMin = std::max(tMin, std::min(t1, t2));
+		tMax = std::min(tMax, std::max(t1, t2));
+		if (tMin > tMax)
+			return false;
+	}
+	fraction = tMin;
+	return true;
+}
+
+// lower id first, sorted, so pair lists from different broadphases compare
+std::vector<std::pair<unsigned int, unsigned int>> SortedPairs(const std::vector<ProxyPair>& pairs)
+{
+	std::vector<std::pair<unsigned int, unsigned int>> sorted;
+	for (const ProxyPair& pair : pairs)
+	{
+		sorted.push_back(std::make_pair(std::min(pair.a, pair.b), std::max(pair.a, pair.b)));
+	}
+	std::sort(sorted.begin(), sorted.end());
+	return sorted;
+}
+
+int PairMismatches(const std::vector<std::pair<unsigned int, unsigned int>>& a, const std::vector<std::pair<unsigned int, unsigned int>>& b)
+{
+	std::vector<std::pair<unsigned int, unsigned int>> difference;
+	std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(difference));
+	return difference.size();
+}
+
+void RunBroadphase()
+{
+	int counts[] = { 100, 1000, 3000 };
+	const int FRAMES = 30;
+	const int QUERIES = 200;
+
+	cout << endl << "BROADPHASE (" << FRAMES << " frames, as many static boxes as moving ones)" << endl;
+	cout << "moving\tsweep and prune ms\ttree ms\tbrute force ms\tpairs\tpair mismatches (sap / tree)\tquery misses\tray mismatches (of hits)" << endl;
+	for (int count : counts)
+	{
+		srand(0);
+		float side = std::sqrt((float)count) * 4.0f;
+		std::vector<Aabb> boxes;
+		std::vector<glm::vec3> velocity;
+		std::vector<bool> isStatic;
+		CollisionWorld sweep;
+		AabbTree tree;
+		for (int i = 0; i < 2 * count; i++)
+		{
+			float x = (rand() % 10000) * 0.0001f * side;
+			float z = (rand() % 10000) * 0.0001f * side;
+			float half = 0.25f + (rand() % 100) * 0.005f;
+			Aabb box(x - half, x + half, z - half, z + half);
+			bool still = i % 2 == 1;
+			boxes.push_back(box);
+			isStatic.push_back(still);
+			velocity.push_back(still ? glm::vec3(0.0f) : glm::vec3(rand() % 401 - 200, 0.0f, rand() % 401 - 200) * 0.01f);
+			sweep.Add(box, still);
+			tree.Add(box, still);
+		}
+
+		double sweepTime = 0.0, treeTime = 0.0, bruteTime = 0.0;
+		int sweepMismatches = 0, treeMismatches = 0;
+		size_t pairCount = 0;
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			for (unsigned int i = 0; i < boxes.size(); i++)
+			{
+				if (isStatic[i])
+					continue;
+
+				// bounce off the edges of the area
+				glm::vec3 step = velocity[i] * DELTA;
+				float cx = (boxes[i].left + boxes[i].right) * 0.5f + step.x;
+				float cz = (boxes[i].down + boxes[i].up) * 0.5f + step.z;
+				if (cx < 0.0f || cx > side) velocity[i].x = -velocity[i].x;
+				if (cz < 0.0f || cz > side) velocity[i].z = -velocity[i].z;
+				boxes[i] = Aabb(boxes[i].left + step.x, boxes[i].right + step.x, boxes[i].down + step.z, boxes[i].up + step.z);
+				sweep.Move(i, boxes[i]);
+				tree.Move(i, boxes[i], step);
+			}
+
+			auto start = chrono::high_resolution_clock::now();
+			std::vector<std::pair<unsigned int, unsigned int>> sweepPairs = SortedPairs(sweep.FindPairs());
+			auto sweepEnd = chrono::high_resolution_clock::now();
+			std::vector<std::pair<unsigned int, unsigned int>> treePairs = SortedPairs(tree.FindPairs());
+			auto treeEnd = chrono::high_resolution_clock::now();
+			std::vector<ProxyPair> brute;
+			for (unsigned int a = 0; a < boxes.size(); a++)
+			{
+				for (unsigned int b = a + 1; b < boxes.size(); b++)
+				{
+					if ((!isStatic[a] || !isStatic[b]) && boxes[a].Overlaps(boxes[b]))
+						brute.push_back({ a, b });
+				}
+			}
+			std::vector<std::pair<unsigned int, unsigned int>> brutePairs = SortedPairs(brute);
+			auto bruteEnd = chrono::high_resolution_clock::now();
+
+			sweepTime += chrono::duration<double, std::milli>(sweepEnd - start).count();
+			treeTime += chrono::duration<double, std::milli>(treeEnd - sweepEnd).count();
+			bruteTime += chrono::duration<double, std::milli>(bruteEnd - treeEnd).count();
+			sweepMismatches += PairMismatches(sweepPairs, brutePairs);
+			treeMismatches += PairMismatches(treePairs, brutePairs);
+			pairCount += brutePairs.size();
+		}
+
+		// every box the query overlaps has to be visited (fat boxes may add more)
+		int queryMisses = 0;
+		int rayMismatches = 0;
+		int rayHits = 0;
+		for (int q = 0; q < QUERIES; q++)
+		{
+			float x = (rand() % 10000) * 0.0001f * side;
+			float z = (rand() % 10000) * 0.0001f * side;
+			float half = 0.5f + (rand() % 100) * 0.03f;
+			Aabb query(x - half, x + half, z - half, z + half);
+			std::vector<bool> visited(boxes.size(), false);
+			tree.QueryBox(query, [&](unsigned int proxy) { visited[proxy] = true; });
+			for (unsigned int i = 0; i < boxes.size(); i++)
+			{
+				if (query.Overlaps(boxes[i]) && !visited[i])
+					queryMisses++;
+			}
+
+			// the closest box along a segment, clipping the tree walk as hits come in
+			float angle = (rand() % 6283) * 0.001f;
+			float length = (rand() % 100) * 0.01f * side * 0.5f;
+			glm::vec3 from(x, 0.0f, z);
+			glm::vec3 to = from + glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * length;
+			float treeNearest = 2.0f;
+			tree.RayCast(from, to, [&](unsigned int proxy, float maxFraction)
+			{
+				float fraction;
+				if (SegmentEntry(boxes[proxy], from, to, fraction) && fraction < maxFraction)
+				{
+					treeNearest = fraction;
+					return fraction;
+				}
+				return maxFraction;
+			});
+			float bruteNearest = 2.0f;
+			for (unsigned int i = 0; i < boxes.size(); i++)
+			{
+				float fraction;
+				if (SegmentEntry(boxes[i], from, to, fraction))
+					bruteNearest = std::min(bruteNearest, fraction);
+			}
+			if (bruteNearest <= 1.0f)
+				rayHits++;
+			if (std::fabs(treeNearest - bruteNearest) > 1e-5f)
+				rayMismatches++;
+		}
+
+		cout << count << "\t" << sweepTime / FRAMES << "\t\t" << treeTime / FRAMES << "\t\t" << bruteTime / FRAMES << "\t\t" << pairCount / FRAMES
+			<< "\t" << sweepMismatches << " / " << treeMismatches << "\t\t\t" << queryMisses << "\t\t" << rayMismatches << " (" << rayHits << ")" << endl;
+	}
+}
+
+#pragma endregion
+
+#pragma region PARTICLES
+
+// one emitter of count particles, lifetimes spread so a few die every step
+void CreateParticles(ParticleStore& store, int count)
+{
+	srand(0);
+	store.Reserve(count);
+	store.gravity = -10.0f;
+	store.drag = 0.2f;
+	unsigned int spawned = count;
+	store.Spawn(spawned);
+	for (int i = 0; i < count; i++)
+	{
+		store.PositionY()[i] = 2.5f;
+		store.Scale()[i] = 1.0f;
+		store.VelocityX()[i] = (rand() % 200 - 100) * 0.03f;
+		store.VelocityY()[i] = (rand() % 100) * 0.03f;
+		store.VelocityZ()[i] = (rand() % 200 - 100) * 0.03f;
+		store.Life()[i] = 0.5f + (rand() % 1000) * 0.01f;
+	}
+}
+
+void RunParticles()
+{
+	int counts[] = { 10000, 100000, 1000000 };
+	const int EMITTERS = 8;
+	ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+
+	cout << endl << "PARTICLES (" << TICKS << " steps, " << pool.ThreadCount() << " threads)" << endl;
+	cout << "particles\tstep ms\tns per particle\tthreaded ms\t" << EMITTERS << " emitters ms\tlive after" << endl;
+	for (int count : counts)
+	{
+		ParticleStore store;
+		CreateParticles(store, count);
+		double stepTime = TimeTicks([&]()
+		{
+			store.Step(DELTA);
+		});
+
+		ParticleStore threaded;
+		CreateParticles(threaded, count);
+		threaded.SetThreadPool(&pool);
+		double threadedTime = TimeTicks([&]()
+		{
+			threaded.Step(DELTA);
+		});
+
+		// the same particles split over several emitters stepped together
+		std::vector<ParticleStore> emitters(EMITTERS);
+		std::vector<ParticleStore*> stores;
+		for (ParticleStore& emitter : emitters)
+		{
+			CreateParticles(emitter, count / EMITTERS);
+			stores.push_back(&emitter);
+		}
+		double emittersTime = TimeTicks([&]()
+		{
+			ParticleStore::StepAll(stores, DELTA, &pool);
+		});
+
+		cout << count << "\t\t" << stepTime << "\t" << stepTime * 1e6 / count << "\t\t" << threadedTime << "\t\t" << emittersTime << "\t\t" << store.LiveCount() << endl;
+	}
+
+	cout << "burst\t\tmemset ms\tuniform ms\tdirection ms" << endl;
+	for (int count : counts)
+	{
+		std::vector<float> x(count), y(count), z(count);
+		Random& random = Random::ForThread();
+		double memsetTime = TimeTicks([&]()
+		{
+			memset(x.data(), 0, count * sizeof(float));
+			memset(y.data(), 0, count * sizeof(float));
+			memset(z.data(), 0, count * sizeof(float));
+		});
+		double uniformTime = TimeTicks([&]()
+		{
+			random.FillUniform(x.data(), count, -1.0f, 1.0f);
+			random.FillUniform(y.data(), count, 0.0f, 1.0f);
+			random.FillUniform(z.data(), count, -1.0f, 1.0f);
+		});
+		double directionTime = TimeTicks([&]()
+		{
+			random.FillDirection(x.data(), y.data(), z.data(), count);
+		});
+		cout << count << "\t\t" << memsetTime << "\t\t" << uniformTime << "\t\t" << directionTime << endl;
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(3.0f, 10.0f, 30.0f), glm::vec3(0.0f, 2.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	cout << "depth sort\t16 bit ms\t32 bit ms\tthreaded ms\tstd::sort ms" << endl;
+	for (int count : counts)
+	{
+		ParticleStore store;
+		CreateParticles(store, count);
+		store.Step(0.5f);
+		unsigned int live = store.LiveCount();
+
+		DepthSorter narrow, wide, threaded;
+		wide.wideKeys = true;
+		threaded.SetThreadPool(&pool);
+		double narrowTime = TimeTicks([&]()
+		{
+			narrow.Sort(store.PositionX(), store.PositionY(), store.PositionZ(), live, view);
+		});
+		double wideTime = TimeTicks([&]()
+		{
+			wide.Sort(store.PositionX(), store.PositionY(), store.PositionZ(), live, view);
+		});
+		double threadedTime = TimeTicks([&]()
+		{
+			threaded.Sort(store.PositionX(), store.PositionY(), store.PositionZ(), live, view);
+		});
+
+		std::vector<float> depth(live);
+		std::vector<unsigned int> order(live);
+		double referenceTime = TimeTicks([&]()
+		{
+			for (unsigned int i = 0; i < live; i++)
+			{
+				depth[i] = view[0][2] * store.PositionX()[i] + view[1][2] * store.PositionY()[i] + view[2][2] * store.PositionZ()[i] + view[3][2];
+				order[i] = i;
+			}
+			std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return depth[a] < depth[b]; });
+		}, 3);
+		cout << live << "\t\t" << narrowTime << "\t\t" << wideTime << "\t\t" << threadedTime << "\t\t" << referenceTime << endl;
+	}
+
+	// ParticleSystem defaults: launch speed 3, 2 s lives, gravity -10, drag 0.2,
+	// 5 seconds at 60 frames per second. Spawns and deaths move particles to
+	// other slots and always need a sort, so a steady stream re-sorts every
+	// frame while bursts that live and die together can reuse the order.
+	// The worst inversion is how far out of order the drawn order got.
+	cout << "sort gate\tframes\tsorted\tskipped\tworst inversion (10k particles, still camera)" << endl;
+	for (int bursts = 0; bursts < 2; bursts++)
+	{
+		const int FRAMES = 300;
+		const unsigned int PARTICLES = 10000;
+		ParticleStore store;
+		store.Reserve(PARTICLES);
+		store.gravity = -10.0f;
+		store.drag = 0.2f;
+		DepthSorter sorter;
+		Random random(7, 0);
+		glm::mat4 frameView = glm::lookAt(glm::vec3(0.0f, 10.0f, 30.0f), glm::vec3(0.0f, 2.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		unsigned int sortedSlots = 0;
+		int sorts = 0;
+		float worst = 0.0f;
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			if (!bursts || frame % 150 == 0)
+			{
+				unsigned int spawned = PARTICLES;
+				unsigned int first = store.Spawn(spawned);
+				random.FillUniform(store.VelocityX() + first, spawned, -3.0f, 3.0f);
+				random.FillUniform(store.VelocityY() + first, spawned, 0.0f, 3.0f);
+				random.FillUniform(store.VelocityZ() + first, spawned, -3.0f, 3.0f);
+				if (bursts)
+					std::fill_n(store.Life() + first, spawned, 2.0f);
+				else
+					random.FillUniform(store.Life() + first, spawned, 0.0f, 2.0f);
+				std::fill_n(store.PositionY() + first, spawned, 2.5f);
+				std::fill_n(store.PositionX() + first, spawned, 0.0f);
+				std::fill_n(store.PositionZ() + first, spawned, 0.0f);
+			}
+
+			store.Step(DELTA);
+			sorter.Moved(store.MaxSpeed() * DELTA);
+
+			unsigned int live = store.LiveCount();
+			if (sorter.NeedsSort(frameView) || store.SlotVersion() != sortedSlots || sorter.Order().size() != live)
+			{
+				sorter.Sort(store.PositionX(), store.PositionY(), store.PositionZ(), live, frameView);
+				sortedSlots = store.SlotVersion();
+				sorts++;
+			}
+
+			// view z only grows along a back to front order
+			const std::vector<unsigned int>& order = sorter.Order();
+			float deepest = -1e30f;
+			for (unsigned int k = 0; k < live; k++)
+			{
+				unsigned int i = order[k];
+				float z = frameView[0][2] * store.PositionX()[i] + frameView[1][2] * store.PositionY()[i] + frameView[2][2] * store.PositionZ()[i] + frameView[3][2];
+				worst = std::max(worst, deepest - z);
+				deepest = std::max(deepest, z);
+			}
+		}
+		cout << (bursts ? "bursts\t\t" : "stream\t\t") << FRAMES << "\t" << sorts << "\t" << FRAMES - sorts << "\t" << worst << endl;
+	}
+}
+
+#pragma endregion
+
+void RunComparison(const std::vector<Body>& obstaclesIn, const DistanceField& obstacleField)
+{
+	std::vector<Body> obstacles = obstaclesIn;
+	int counts[] = { 200, 1000, 5000 };
+
+	cout << "simd lanes: " << SimdFloat::Width << endl;
+	cout << "boids\tthree-pass ms\tfused ms\tsoa ms\tsoa k-nearest ms\tspeedup (three-pass / fused / soa)" << endl;
+	for (int count : counts)
+	{
+		std::vector<Body> reference = CreateFlock(count);
+		double referenceTime = TimeTicks([&]()
+		{
+			BoidRule1(reference);
+			BoidRule2(reference, obstacles);
+			BoidRule3(reference);
+			Integrate(reference);
+			CollideObstacles(reference, obstacles);
+		});
+
+		std::vector<Body> fused = CreateFlock(count);
+		FlockRules rules;
+		double fusedTime = TimeTicks([&]()
+		{
+			rules.Apply(fused, obstacles, target);
+			Integrate(fused);
+			CollideObstacles(fused, obstacles);
+		});
+
+		Flock flock;
+		flock.topSpeed = 0.2f;
+		flock.SetObstacleField(&obstacleField);
+		for (const Body& boid : CreateFlock(count))
+		{
+			flock.Add(boid.position);
+		}
+		double soaTime = TimeTicks([&]()
+		{
+			flock.Step(target, DELTA);
+		});
+
+		flock.Clear();
+		flock.params.neighbourMode = NeighbourMode::KNearest;
+		for (const Body& boid : CreateFlock(count))
+		{
+			flock.Add(boid.position);
+		}
+		double nearestTime = TimeTicks([&]()
+		{
+			flock.Step(target, DELTA);
+		});
+
+		cout << count << "\t" << referenceTime << "\t\t" << fusedTime << "\t\t" << soaTime << "\t" << nearestTime << "\t\t"
+			<< "1 / " << referenceTime / fusedTime << " / " << referenceTime / soaTime << endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::vector<int>> obstaclesGrid = CreateObstaclesGrid();
+	std::vector<Body> obstacles = CreateObstacles(obstaclesGrid);
+	DistanceField obstacleField;
+	obstacleField.Build(obstaclesGrid, obstaclesOffset, 4, 2.0f);
+
+	bool compare = argc < 2 || strcmp(argv[1], "compare") == 0;
+	bool stress = argc < 2 || strcmp(argv[1], "stress") == 0;
+	bool physics = argc < 2 || strcmp(argv[1], "physics") == 0;
+	bool raycast = argc < 2 || strcmp(argv[1], "raycast") == 0;
+	bool broadphase = argc < 2 || strcmp(argv[1], "broadphase") == 0;
+	bool particles = argc < 2 || strcmp(argv[1], "particles") == 0;
+
+	if (compare)
+	{
+		RunComparison(obstacles, obstacleField);
+	}
+	if (stress)
+	{
+		RunStress(obstacleField);
+	}
+	if (physics)
+	{
+		RunPhysics();
+	}
+	if (raycast)
+	{
+		RunRaycast(obstaclesGrid);
+	}
+	if (broadphase)
+	{
+		RunBroadphase();
+	}
+	if (particles)
+	{
+		RunParticles();
+	}
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "Body.h"
+
+#include <limits>
+
+// two overlapping broadphase proxies
+struct ProxyPair
+{
+	unsigned int a;
+	unsigned int b;
+};
+
+// Bounding box on the x/z plane, same sides as Body.
+struct Aabb
+{
+	float left;
+	float right;
+	float down;
+	float up;
+
+	Aabb() : left(0.0f), right(0.0f), down(0.0f), up(0.0f) {}
+	Aabb(float left, float right, float down, float up) : left(left), right(right), down(down), up(up) {}
+
+	static Aabb FromBody(const Body& body)
+	{
+		return Aabb(body.left, body.right, body.down, body.up);
+	}
+
+	// strict like CheckCollision, touching boxes do not overlap
+	bool Overlaps(const Aabb& other) const
+	{
+		return left < other.right && right > other.left && up > other.down && down < other.up;
+	}
+
+	// overlap along the axis this box is least deep in, the normal points out
+	// of the other box
+	bool Penetration(const Aabb& other, float& normalX, float& normalZ, float& depth) const
+	{
+		if (!Overlaps(other))
+			return false;
+
+		float depths[4] = { other.right - left, right - other.left, other.up - down, up - other.down };
+		float normalsX[4] = { 1.0f, -1.0f, 0.0f, 0.0f };
+		float normalsZ[4] = { 0.0f, 0.0f, 1.0f, -1.0f };
+		int axis = 0;
+		for (int k = 1; k < 4; k++)
+		{
+			if (depths[k] < depths[axis])
+				axis = k;
+		}
+		normalX = normalsX[axis];
+		normalZ = normalsZ[axis];
+		depth = depths[axis];
+		return true;
+	}
+
+	// moves this box by (dx, dz) towards a static box, time is the fraction of
+	// the move where they first touch and the normal points out of the other
+	// box. Boxes that already overlap or only graze each other do not hit.
+	bool Sweep(const Aabb& other, float dx, float dz, float& time, float& normalX, float& normalZ) const
+	{
+		const float infinity = std::numeric_limits<float>::infinity();
+		float entryX = -infinity, exitX = infinity;
+		float entryZ = -infinity, exitZ = infinity;
+
+		if (dx > 0.0f) { entryX = (other.left - right) / dx; exitX = (other.right - left) / dx; }
+		else if (dx < 0.0f) { entryX = (other.right - left) / dx; exitX = (other.left - right) / dx; }
+		else if (right <= other.left || left >= other.right) return false;
+
+		if (dz > 0.0f) { entryZ = (other.down - up) / dz; exitZ = (other.up - down) / dz; }
+		else if (dz < 0.0f) { entryZ = (other.up - down) / dz; exitZ = (other.down - up) / dz; }
+		else if (up <= other.down || down >= other.up) return false;
+
+		float entry = entryX > entryZ ? entryX : entryZ;
+		float exit = exitX < exitZ ? exitX : exitZ;
+		if (entry >= exit || entry < 0.0f || entry > 1.0f)
+			return false;
+
+		time = entry;
+		normalX = 0.0f;
+		normalZ = 0.0f;
+		if (entryX > entryZ)
+			normalX = dx > 0.0f ? -1.0f : 1.0f;
+		else
+			normalZ = dz > 0.0f ? -1.0f : 1.0f;
+		return true;
+	}
+};
+
+#endif // !AABB_H
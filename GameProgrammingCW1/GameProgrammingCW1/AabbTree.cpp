@@ -0,0 +1,390 @@
+#include "AabbTree.h"
+#include <cmath>
+
+AabbTree::AabbTree(float fatMargin) : fatMargin(fatMargin)
+{
+}
+
+AabbTree::~AabbTree()
+{
+}
+
+unsigned int AabbTree::Add(const Aabb& box, bool isStatic)
+{
+	unsigned int proxy;
+	if (!freeProxies.empty())
+	{
+		proxy = freeProxies.back();
+		freeProxies.pop_back();
+	}
+	else
+	{
+		proxy = proxies.size();
+		proxies.push_back(Proxy());
+	}
+
+	int leaf = allocateNode();
+	nodes[leaf].box = Aabb(box.left - fatMargin, box.right + fatMargin, box.down - fatMargin, box.up + fatMargin);
+	nodes[leaf].height = 0;
+	nodes[leaf].proxy = proxy;
+
+	proxies[proxy].box = box;
+	proxies[proxy].leaf = leaf;
+	proxies[proxy].isStatic = isStatic;
+	proxies[proxy].isSleeping = false;
+
+	insertLeaf(leaf);
+	return proxy;
+}
+
+bool AabbTree::Move(unsigned int proxy, const Aabb& box, glm::vec3 displacement)
+{
+	Proxy& p = proxies[proxy];
+	p.box = box;
+	if (contains(nodes[p.leaf].box, box))
+		return false;
+
+	removeLeaf(p.leaf);
+
+	// fatten and stretch along the motion so the next few frames stay inside
+	Aabb fat(box.left - fatMargin, box.right + fatMargin, box.down - fatMargin, box.up + fatMargin);
+	float dx = 2.0f * displacement.x;
+	float dz = 2.0f * displacement.z;
+	if (dx < 0.0f) fat.left += dx; else fat.right += dx;
+	if (dz < 0.0f) fat.down += dz; else fat.up += dz;
+	nodes[p.leaf].box = fat;
+
+	insertLeaf(p.leaf);
+	return true;
+}
+
+void AabbTree::Remove(unsigned int proxy)
+{
+	int leaf = proxies[proxy].leaf;
+	removeLeaf(leaf);
+	freeNodeAt(leaf);
+	proxies[proxy].leaf = NULL_NODE;
+	freeProxies.push_back(proxy);
+}
+
+const std::vector<ProxyPair>& AabbTree::FindPairs()
+{
+	pairs.clear();
+	for (unsigned int p = 0; p < proxies.size(); p++)
+	{
+		if (!proxies[p].Queries())
+			continue;
+
+		const Aabb& box = proxies[p].box;
+		QueryBox(box, [&](unsigned int q) {
+			// two awake moving proxies are reported once, from the lower id
+			if (q == p || (proxies[q].Queries() && q < p))
+				return;
+			if (box.Overlaps(proxies[q].box))
+			{
+				pairs.push_back({ p, q });
+			}
+		});
+	}
+	return pairs;
+}
+
+int AabbTree::allocateNode()
+{
+	int index;
+	if (freeNode != NULL_NODE)
+	{
+		index = freeNode;
+		freeNode = nodes[index].parent;
+	}
+	else
+	{
+		index = nodes.size();
+		nodes.push_back(Node());
+	}
+
+	Node& node = nodes[index];
+	node.parent = NULL_NODE;
+	node.child1 = NULL_NODE;
+	node.child2 = NULL_NODE;
+	node.height = 0;
+	node.proxy = 0;
+	return index;
+}
+
+void AabbTree::freeNodeAt(int index)
+{
+	nodes[index].parent = freeNode;
+	nodes[index].height = -1;
+	freeNode = index;
+}
+
+void AabbTree::insertLeaf(int leaf)
+{
+	if (root == NULL_NODE)
+	{
+		root = leaf;
+		nodes[root].parent = NULL_NODE;
+		return;
+	}
+
+	// walk down to the sibling that grows the tree perimeter the least
+	Aabb leafBox = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].IsLeaf())
+	{
+		const Node& node = nodes[index];
+		float area = perimeter(node.box);
+		float combinedArea = perimeter(combine(node.box, leafBox));
+
+		// cost of a new parent here, and of pushing the leaf further down
+		float cost = 2.0f * combinedArea;
+		float inheritance = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		int children[2] = { node.child1, node.child2 };
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child = nodes[children[c]];
+			float grown = perimeter(combine(leafBox, child.box));
+			childCost[c] = (child.IsLeaf() ? grown : grown - perimeter(child.box)) + inheritance;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = combine(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent != NULL_NODE)
+	{
+		if (nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+	}
+	else
+	{
+		root = newParent;
+	}
+
+	refit(nodes[leaf].parent);
+}
+
+void AabbTree::removeLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = NULL_NODE;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent != NULL_NODE)
+	{
+		if (nodes[grandParent].child1 == parent)
+			nodes[grandParent].child1 = sibling;
+		else
+			nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+		freeNodeAt(parent);
+
+		refit(grandParent);
+	}
+	else
+	{
+		root = sibling;
+		nodes[sibling].parent = NULL_NODE;
+		freeNodeAt(parent);
+	}
+}
+
+// balance and fix boxes and heights from index up to the root
+void AabbTree::refit(int index)
+{
+	while (index != NULL_NODE)
+	{
+		index = balance(index);
+
+		Node& node = nodes[index];
+		const Node& child1 = nodes[node.child1];
+		const Node& child2 = nodes[node.child2];
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.box = combine(child1.box, child2.box);
+
+		index = node.parent;
+	}
+}
+
+// rotate the taller child up when the subtree heights differ by more than one,
+// returns the index of the subtree's new top node
+int AabbTree::balance(int indexA)
+{
+	Node& a = nodes[indexA];
+	if (a.IsLeaf() || a.height < 2)
+		return indexA;
+
+	int indexB = a.child1;
+	int indexC = a.child2;
+	Node& b = nodes[indexB];
+	Node& c = nodes[indexC];
+
+	int difference = c.height - b.height;
+
+	// C goes up, A takes the shorter child of C
+	if (difference > 1)
+	{
+		int indexF = c.child1;
+		int indexG = c.child2;
+		Node& f = nodes[indexF];
+		Node& g = nodes[indexG];
+
+		c.child1 = indexA;
+		c.parent = a.parent;
+		a.parent = indexC;
+
+		if (c.parent != NULL_NODE)
+		{
+			if (nodes[c.parent].child1 == indexA)
+				nodes[c.parent].child1 = indexC;
+			else
+				nodes[c.parent].child2 = indexC;
+		}
+		else
+		{
+			root = indexC;
+		}
+
+		if (f.height > g.height)
+		{
+			c.child2 = indexF;
+			a.child2 = indexG;
+			g.parent = indexA;
+			a.box = combine(b.box, g.box);
+			c.box = combine(a.box, f.box);
+			a.height = 1 + std::max(b.height, g.height);
+			c.height = 1 + std::max(a.height, f.height);
+		}
+		else
+		{
+			c.child2 = indexG;
+			a.child2 = indexF;
+			f.parent = indexA;
+			a.box = combine(b.box, f.box);
+			c.box = combine(a.box, g.box);
+			a.height = 1 + std::max(b.height, f.height);
+			c.height = 1 + std::max(a.height, g.height);
+		}
+		return indexC;
+	}
+
+	// B goes up, A takes the shorter child of B
+	if (difference < -1)
+	{
+		int indexD = b.child1;
+		int indexE = b.child2;
+		Node& d = nodes[indexD];
+		Node& e = nodes[indexE];
+
+		b.child1 = indexA;
+		b.parent = a.parent;
+		a.parent = indexB;
+
+		if (b.parent != NULL_NODE)
+		{
+			if (nodes[b.parent].child1 == indexA)
+				nodes[b.parent].child1 = indexB;
+			else
+				nodes[b.parent].child2 = indexB;
+		}
+		else
+		{
+			root = indexB;
+		}
+
+		if (d.height > e.height)
+		{
+			b.child2 = indexD;
+			a.child1 = indexE;
+			e.parent = indexA;
+			a.box = combine(c.box, e.box);
+			b.box = combine(a.box, d.box);
+			a.height = 1 + std::max(c.height, e.height);
+			b.height = 1 + std::max(a.height, d.height);
+		}
+		else
+		{
+			b.child2 = indexE;
+			a.child1 = indexD;
+			d.parent = indexA;
+			a.box = combine(c.box, d.box);
+			b.box = combine(a.box, e.box);
+			a.height = 1 + std::max(c.height, d.height);
+			b.height = 1 + std::max(a.height, e.height);
+		}
+		return indexB;
+	}
+
+	return indexA;
+}
+
+Aabb AabbTree::combine(const Aabb& a, const Aabb& b)
+{
+	return Aabb(std::min(a.left, b.left), std::max(a.right, b.right), std::min(a.down, b.down), std::max(a.up, b.up));
+}
+
+float AabbTree::perimeter(const Aabb& box)
+{
+	return 2.0f * ((box.right - box.left) + (box.up - box.down));
+}
+
+bool AabbTree::contains(const Aabb& outer, const Aabb& inner)
+{
+	return outer.left <= inner.left && outer.right >= inner.right && outer.down <= inner.down && outer.up >= inner.up;
+}
+
+// slab test of the segment x + t * dx, z + t * dz for t in [0, maxFraction]
+bool AabbTree::rayHits(const Aabb& box, float x, float z, float dx, float dz, float maxFraction)
+{
+	float tMin = 0.0f;
+	float tMax = maxFraction;
+
+	float origin[2] = { x, z };
+	float direction[2] = { dx, dz };
+	float low[2] = { box.left, box.down };
+	float high[2] = { box.right, box.up };
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (std::fabs(direction[axis]) < 1e-8f)
+		{
+			if (origin[axis] < low[axis] || origin[axis] > high[axis])
+				return false;
+			continue;
+		}
+
+		float inverse = 1.0f / direction[axis];
+		float t1 = (low[axis] - origin[axis]) * inverse;
+		float t2 = (high[axis] - origin[axis]) * inverse;
+		if (t1 > t2)
+			std::swap(t1, t2);
+		tMin = std::max(tMin, t1);
+		tMax = std::min(tMax, t2);
+		if (tMin > tMax)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,157 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+
+#include "Aabb.h"
+
+// Dynamic bounding volume tree on the x/z plane for bodies that are not grid
+// aligned, static or moving.
+// Leaves store a box fattened by a margin (and stretched along the motion),
+// a proxy is only reinserted when its box leaves the fat one. The tree is kept
+// balanced with rotations like an AVL tree.
+class AabbTree
+{
+public:
+	AabbTree(float fatMargin = 0.1f);
+	~AabbTree();
+
+	// returns the proxy id
+	unsigned int Add(const Aabb& box, bool isStatic);
+	// displacement is the movement expected next frame, returns true when the
+	// proxy was reinserted
+	bool Move(unsigned int proxy, const Aabb& box, glm::vec3 displacement = glm::vec3(0.0f));
+	void Remove(unsigned int proxy);
+
+	const Aabb& Box(unsigned int proxy) const { return proxies[proxy].box; }
+	const Aabb& FatBox(unsigned int proxy) const { return nodes[proxies[proxy].leaf].box; }
+	bool IsStatic(unsigned int proxy) const { return proxies[proxy].isStatic; }
+	// sleeping proxies are treated like static ones until woken
+	void SetSleeping(unsigned int proxy, bool isSleeping) { proxies[proxy].isSleeping = isSleeping; }
+	int Height() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+	// overlapping pairs with at least one awake moving proxy, a is one of them
+	const std::vector<ProxyPair>& FindPairs();
+
+	// visit(proxy) for every proxy whose fat box overlaps the box
+	template <typename Visit>
+	void QueryBox(const Aabb& box, Visit visit) const
+	{
+		if (root == NULL_NODE)
+			return;
+
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			int index = stack.back();
+			stack.pop_back();
+
+			const Node& node = nodes[index];
+			if (!node.box.Overlaps(box))
+				continue;
+
+			if (node.IsLeaf())
+			{
+				visit(node.proxy);
+			}
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+
+	// segment from start to end on the x/z plane, visit(proxy, maxFraction) is
+	// called for proxies whose fat box the segment crosses and returns the new
+	// max fraction along the segment (0 stops the query)
+	template <typename Visit>
+	void RayCast(glm::vec3 start, glm::vec3 end, Visit visit) const
+	{
+		if (root == NULL_NODE)
+			return;
+
+		float dx = end.x - start.x;
+		float dz = end.z - start.z;
+		float maxFraction = 1.0f;
+
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			int index = stack.back();
+			stack.pop_back();
+
+			const Node& node = nodes[index];
+			if (!rayHits(node.box, start.x, start.z, dx, dz, maxFraction))
+				continue;
+
+			if (node.IsLeaf())
+			{
+				maxFraction = visit(node.proxy, maxFraction);
+				if (maxFraction <= 0.0f)
+					return;
+			}
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+
+private:
+	static const int NULL_NODE = -1;
+
+	struct Node
+	{
+		Aabb box;
+		int parent;		// next free node when unused
+		int child1;
+		int child2;
+		int height;		// leaves are 0, free nodes -1
+		unsigned int proxy;
+
+		bool IsLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	struct Proxy
+	{
+		Aabb box;
+		int leaf;
+		bool isStatic;
+		bool isSleeping;
+
+		bool Queries() const { return leaf != NULL_NODE && !isStatic && !isSleeping; }
+	};
+
+	float fatMargin;
+
+	std::vector<Node> nodes;
+	int root = NULL_NODE;
+	int freeNode = NULL_NODE;
+
+	std::vector<Proxy> proxies;
+	std::vector<unsigned int> freeProxies;
+
+	std::vector<ProxyPair> pairs;
+	mutable std::vector<int> stack;
+
+	int allocateNode();
+	void freeNodeAt(int index);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int index);
+	void refit(int index);
+
+	static Aabb combine(const Aabb& a, const Aabb& b);
+	static float perimeter(const Aabb& box);
+	static bool contains(const Aabb& outer, const Aabb& inner);
+	static bool rayHits(const Aabb& box, float x, float z, float dx, float dz, float maxFraction);
+};
+
+#endif // !AABB_TREE_H
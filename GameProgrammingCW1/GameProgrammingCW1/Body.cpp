@@ -1,4 +1,5 @@
 #include "Body.h"
+#include "Log.h"
 
 Body::Body(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
 {
@@ -58,22 +59,22 @@ void Body::CalculateDirection()
 	addedForce = glm::vec3(0, 0, 0);
 	if (velocity.x > 0) {
 		direction = Direction::Left;
-		if (!isBoid)printf(" LEFT \n");
+		if (!isBoid)LOG_DEBUG(LogCategory::Physics, "LEFT");
 
 	}
 	else if (velocity.x < 0) {
 		direction = Direction::Right;
-		if (!isBoid)printf(" RIGHT \n");
+		if (!isBoid)LOG_DEBUG(LogCategory::Physics, "RIGHT");
 
 	}
 	else if (velocity.z > 0) {
 		if (!isBoid)direction =Direction::Up;
-		if (!isBoid)printf(" UP \n");
+		if (!isBoid)LOG_DEBUG(LogCategory::Physics, "UP");
 
 	}
 	else if (velocity.z < 0) {
 		direction = Direction::Down;
-		if (!isBoid)printf(" DOWN \n");
+		if (!isBoid)LOG_DEBUG(LogCategory::Physics, "DOWN");
 
 	}
 }
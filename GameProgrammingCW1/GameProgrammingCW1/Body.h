@@ -1,7 +1,7 @@
 #ifndef BODY_H
 #define BODY_H
 
-#include "Shapes.h" 
+#include <glm/glm.hpp>
 
 enum class Direction { Left, Right, Up, Down, Idle };
 class Body
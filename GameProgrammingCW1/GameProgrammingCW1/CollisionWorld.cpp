@@ -0,0 +1,134 @@
+#include "CollisionWorld.h"
+#include <algorithm>
+
+// max ends before min ends on equal values, so touching boxes never overlap
+static bool endpointLess(float valueA, bool minA, float valueB, bool minB)
+{
+	return valueA < valueB || (valueA == valueB && !minA && minB);
+}
+
+static void removeActive(std::vector<unsigned int>& active, unsigned int proxy)
+{
+	for (unsigned int i = 0; i < active.size(); i++)
+	{
+		if (active[i] == proxy)
+		{
+			active[i] = active.back();
+			active.pop_back();
+			return;
+		}
+	}
+}
+
+CollisionWorld::CollisionWorld()
+{
+}
+
+CollisionWorld::~CollisionWorld()
+{
+}
+
+unsigned int CollisionWorld::Add(const Aabb& box, bool isStatic)
+{
+	unsigned int proxy;
+	if (!freeProxies.empty())
+	{
+		proxy = freeProxies.back();
+		freeProxies.pop_back();
+	}
+	else
+	{
+		proxy = proxies.size();
+		proxies.push_back(Proxy());
+	}
+	proxies[proxy].box = box;
+	proxies[proxy].isStatic = isStatic;
+	proxies[proxy].alive = true;
+
+	// appended unsorted, the next sort moves them into place
+	endpoints.push_back({ box.left, proxy, true });
+	endpoints.push_back({ box.right, proxy, false });
+	return proxy;
+}
+
+void CollisionWorld::Move(unsigned int proxy, const Aabb& box)
+{
+	proxies[proxy].box = box;
+}
+
+void CollisionWorld::Remove(unsigned int proxy)
+{
+	proxies[proxy].alive = false;
+	freeProxies.push_back(proxy);
+	endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(),
+		[proxy](const Endpoint& e) { return e.proxy == proxy; }), endpoints.end());
+}
+
+const std::vector<ProxyPair>& CollisionWorld::FindPairs()
+{
+	sortEndpoints();
+
+	pairs.clear();
+	activeStatic.clear();
+	activeMoving.clear();
+
+	for (const Endpoint& endpoint : endpoints)
+	{
+		unsigned int proxy = endpoint.proxy;
+		bool isStatic = proxies[proxy].isStatic;
+
+		if (!endpoint.isMin)
+		{
+			removeActive(isStatic ? activeStatic : activeMoving, proxy);
+			continue;
+		}
+
+		// everything active overlaps on x, check z
+		for (unsigned int other : activeMoving)
+		{
+			addPair(isStatic ? other : proxy, isStatic ? proxy : other);
+		}
+		if (!isStatic)
+		{
+			for (unsigned int other : activeStatic)
+			{
+				addPair(proxy, other);
+			}
+		}
+
+		(isStatic ? activeStatic : activeMoving).push_back(proxy);
+	}
+	return pairs;
+}
+
+void CollisionWorld::sortEndpoints()
+{
+	// refresh values from the boxes, then insertion sort the nearly sorted list
+	for (Endpoint& endpoint : endpoints)
+	{
+		const Aabb& box = proxies[endpoint.proxy].box;
+		endpoint.value = endpoint.isMin ? box.left : box.right;
+	}
+
+	for (unsigned int i = 1; i < endpoints.size(); i++)
+	{
+		Endpoint endpoint = endpoints[i];
+		unsigned int j = i;
+		while (j > 0 && endpointLess(endpoint.value, endpoint.isMin, endpoints[j - 1].value, endpoints[j - 1].isMin))
+		{
+			endpoints[j] = endpoints[j - 1];
+			j--;
+		}
+		endpoints[j] = endpoint;
+	}
+}
+
+void CollisionWorld::addPair(unsigned int moving, unsigned int other)
+{
+	const Aabb& a = proxies[moving].box;
+	const Aabb& b = proxies[other].box;
+	if (a.up > b.down && a.down < b.up)
+	{
+		pairs.push_back({ moving, other });
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef COLLISION_WORLD_H
+#define COLLISION_WORLD_H
+
+#include <vector>
+
+#include "Aabb.h"
+
+// Broadphase over the bounding boxes of static and moving bodies.
+// Box ends on the x axis are kept sorted between calls (insertion sort, boxes
+// barely move between frames so it is close to linear) and swept to find the
+// overlapping pairs. Static boxes are only tested against moving ones, pairs
+// of static boxes are never looked at.
+class CollisionWorld
+{
+public:
+	CollisionWorld();
+	~CollisionWorld();
+
+	// returns the proxy id
+	unsigned int Add(const Aabb& box, bool isStatic);
+	void Move(unsigned int proxy, const Aabb& box);
+	void Remove(unsigned int proxy);
+
+	const Aabb& Box(unsigned int proxy) const { return proxies[proxy].box; }
+	bool IsStatic(unsigned int proxy) const { return proxies[proxy].isStatic; }
+
+	// overlapping pairs with at least one moving box, a is the moving one
+	const std::vector<ProxyPair>& FindPairs();
+
+private:
+	struct Proxy
+	{
+		Aabb box;
+		bool isStatic;
+		bool alive;
+	};
+
+	struct Endpoint
+	{
+		float value;
+		unsigned int proxy;
+		bool isMin;
+	};
+
+	std::vector<Proxy> proxies;
+	std::vector<unsigned int> freeProxies;
+	std::vector<Endpoint> endpoints;
+
+	std::vector<unsigned int> activeStatic;
+	std::vector<unsigned int> activeMoving;
+	std::vector<ProxyPair> pairs;
+
+	void sortEndpoints();
+	void addPair(unsigned int moving, unsigned int other);
+};
+
+#endif // !COLLISION_WORLD_H
@@ -0,0 +1,66 @@
+#include "ContactStream.h"
+#include <algorithm>
+
+static bool keyLess(const Contact& x, const Contact& y)
+{
+	return x.a < y.a || (x.a == y.a && x.b < y.b);
+}
+
+ContactStream::ContactStream()
+{
+}
+
+ContactStream::~ContactStream()
+{
+}
+
+void ContactStream::BeginTick(unsigned int chunkCount)
+{
+	if (chunks.size() < chunkCount)
+	{
+		chunks.resize(chunkCount);
+	}
+	for (std::vector<Contact>& chunk : chunks)
+	{
+		chunk.clear();
+	}
+}
+
+void ContactStream::Add(unsigned int chunk, unsigned int a, unsigned int b, float normalX, float normalZ, float penetration)
+{
+	chunks[chunk].push_back({ a, b, ContactState::Stay, normalX, normalZ, penetration });
+}
+
+void ContactStream::EndTick()
+{
+	std::swap(previous, current);
+	current.clear();
+	for (const std::vector<Contact>& chunk : chunks)
+	{
+		current.insert(current.end(), chunk.begin(), chunk.end());
+	}
+	std::sort(current.begin(), current.end(), keyLess);
+
+	// merge of two sorted lists
+	events.clear();
+	unsigned int i = 0, j = 0;
+	while (i < current.size() || j < previous.size())
+	{
+		if (j == previous.size() || (i < current.size() && keyLess(current[i], previous[j])))
+		{
+			events.push_back(current[i++]);
+			events.back().state = ContactState::Begin;
+		}
+		else if (i == current.size() || keyLess(previous[j], current[i]))
+		{
+			events.push_back(previous[j++]);
+			events.back().state = ContactState::End;
+		}
+		else
+		{
+			events.push_back(current[i++]);
+			events.back().state = ContactState::Stay;
+			j++;
+		}
+	}
+}
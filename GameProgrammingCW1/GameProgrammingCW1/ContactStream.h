@@ -0,0 +1,52 @@
+#ifndef CONTACT_STREAM_H
+#define CONTACT_STREAM_H
+
+#include <vector>
+
+enum class ContactState { Begin, Stay, End };
+
+// Two bodies touching, b has WALL set when it is a static tile cell.
+// The normal points from b to a and penetration is how far they overlap along
+// it.
+struct Contact
+{
+	static const unsigned int WALL = 0x80000000u;
+
+	unsigned int a;
+	unsigned int b;
+	ContactState state;
+	float normalX;
+	float normalZ;
+	float penetration;
+
+	bool IsWall() const { return (b & WALL) != 0; }
+	unsigned int Cell() const { return b & ~WALL; }
+};
+
+// Per-tick contact events between detection and response.
+// Detection writes into one buffer per chunk of work, so chunks can run on any
+// thread without sharing anything. EndTick merges the buffers in key order and
+// compares them with the previous tick: new pairs Begin, pairs still touching
+// Stay and pairs that stopped touching End. The events do not depend on the
+// number of threads or the order detection ran in.
+class ContactStream
+{
+public:
+	ContactStream();
+	~ContactStream();
+
+	void BeginTick(unsigned int chunkCount);
+	void Add(unsigned int chunk, unsigned int a, unsigned int b, float normalX, float normalZ, float penetration);
+	void EndTick();
+
+	// events of the last tick, sorted by (a, b)
+	const std::vector<Contact>& Events() const { return events; }
+
+private:
+	std::vector<std::vector<Contact>> chunks;
+	std::vector<Contact> current;
+	std::vector<Contact> previous;
+	std::vector<Contact> events;
+};
+
+#endif // !CONTACT_STREAM_H
@@ -0,0 +1,149 @@
+#include "DepthSorter.h"
+#include <algorithm>
+
+DepthSorter::DepthSorter()
+{
+}
+
+DepthSorter::~DepthSorter()
+{
+}
+
+// camera position and view direction in world space
+static void cameraFrame(const glm::mat4& viewMatrix, glm::vec3& camera, glm::vec3& forward)
+{
+	camera = -glm::transpose(glm::mat3(viewMatrix)) * glm::vec3(viewMatrix[3]);
+	forward = -glm::vec3(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2]);
+}
+
+bool DepthSorter::NeedsSort(const glm::mat4& viewMatrix) const
+{
+	if (!sorted || motion > sortDistance)
+		return true;
+
+	glm::vec3 camera, forward;
+	cameraFrame(viewMatrix, camera, forward);
+	return glm::distance(camera, sortCamera) > sortDistance || glm::dot(forward, sortForward) < sortTurn;
+}
+
+void DepthSorter::Sort(const float* x, const float* y, const float* z, unsigned int count, const glm::mat4& viewMatrix)
+{
+	sorted = true;
+	motion = 0.0f;
+	cameraFrame(viewMatrix, sortCamera, sortForward);
+
+	unsigned int chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	depth.resize(count);
+	keys.resize(count);
+	keysScratch.resize(count);
+	order.resize(count);
+	orderScratch.resize(count);
+	offsets.resize(chunkCount * RADIX);
+	chunkNear.resize(chunkCount);
+	chunkFar.resize(chunkCount);
+
+	// view space z, the camera looks down -z so the farthest point is the lowest
+	float rowX = viewMatrix[0][2], rowY = viewMatrix[1][2], rowZ = viewMatrix[2][2], rowW = viewMatrix[3][2];
+	forChunks(count, [&](unsigned int chunk, unsigned int begin, unsigned int end)
+	{
+		float nearest = -1e30f, farthest = 1e30f;
+		for (unsigned int i = begin; i < end; i++)
+		{
+			float d = rowX * x[i] + rowY * y[i] + rowZ * z[i] + rowW;
+			depth[i] = d;
+			nearest = std::max(nearest, d);
+			farthest = std::min(farthest, d);
+		}
+		chunkNear[chunk] = nearest;
+		chunkFar[chunk] = farthest;
+	});
+	if (count == 0)
+		return;
+
+	float nearest = *std::max_element(chunkNear.begin(), chunkNear.end());
+	float farthest = *std::min_element(chunkFar.begin(), chunkFar.end());
+	double maxKey = wideKeys ? 4294967295.0 : 65535.0;
+	double scale = nearest > farthest ? maxKey / ((double)nearest - farthest) : 0.0;
+
+	// the farthest point gets key 0 so ascending keys are back to front
+	forChunks(count, [&](unsigned int, unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			keys[i] = (unsigned int)std::min(((double)depth[i] - farthest) * scale, maxKey);
+			order[i] = i;
+		}
+	});
+
+	unsigned int passes = wideKeys ? 4 : 2;
+	for (unsigned int pass = 0; pass < passes; pass++)
+	{
+		if (radixPass(count, pass * 8))
+		{
+			keys.swap(keysScratch);
+			order.swap(orderScratch);
+		}
+	}
+}
+
+void DepthSorter::forChunks(unsigned int count, const std::function<void(unsigned int, unsigned int, unsigned int)>& job)
+{
+	unsigned int chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	auto run = [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int chunk = begin; chunk < end; chunk++)
+		{
+			job(chunk, chunk * CHUNK_SIZE, std::min((chunk + 1) * CHUNK_SIZE, count));
+		}
+	};
+
+	if (threads && count >= parallelCount)
+	{
+		threads->ParallelFor(chunkCount, 1, run);
+	}
+	else
+	{
+		run(0, chunkCount);
+	}
+}
+
+bool DepthSorter::radixPass(unsigned int count, unsigned int shift)
+{
+	unsigned int chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	forChunks(count, [&](unsigned int chunk, unsigned int begin, unsigned int end)
+	{
+		unsigned int* counts = &offsets[chunk * RADIX];
+		std::fill(counts, counts + RADIX, 0u);
+		for (unsigned int i = begin; i < end; i++)
+		{
+			counts[(keys[i] >> shift) & (RADIX - 1)]++;
+		}
+	});
+
+	// digit major, chunk minor prefix sum keeps the sort stable
+	unsigned int position = 0;
+	for (unsigned int digit = 0; digit < RADIX; digit++)
+	{
+		unsigned int start = position;
+		for (unsigned int chunk = 0; chunk < chunkCount; chunk++)
+		{
+			unsigned int digitCount = offsets[chunk * RADIX + digit];
+			offsets[chunk * RADIX + digit] = position;
+			position += digitCount;
+		}
+		if (position - start == count)
+			return false;	// one digit for every key, already in order
+	}
+
+	forChunks(count, [&](unsigned int chunk, unsigned int begin, unsigned int end)
+	{
+		unsigned int* next = &offsets[chunk * RADIX];
+		for (unsigned int i = begin; i < end; i++)
+		{
+			unsigned int target = next[(keys[i] >> shift) & (RADIX - 1)]++;
+			keysScratch[target] = keys[i];
+			orderScratch[target] = order[i];
+		}
+	});
+	return true;
+}
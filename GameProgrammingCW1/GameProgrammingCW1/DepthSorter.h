@@ -0,0 +1,65 @@
+#ifndef DEPTH_SORTER_H
+#define DEPTH_SORTER_H
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// Back to front draw order for points, for blended particles.
+// View depth is quantised to 16 bit keys (32 with wideKeys) between the
+// nearest and farthest point and an LSD radix sort, 8 bits per pass, orders
+// an index array by them. Each pass builds a histogram per chunk and scatters
+// every chunk to its own offsets, so on a ThreadPool the order is the same
+// as on one thread. Passes where every key has the same digit are skipped.
+// NeedsSort tells when the last order has gone stale: the camera moved or
+// turned, or the points may have moved sortDistance since the last Sort.
+class DepthSorter
+{
+public:
+	DepthSorter();
+	~DepthSorter();
+
+	// Order() becomes the indices of the count points, farthest first
+	void Sort(const float* x, const float* y, const float* z, unsigned int count, const glm::mat4& viewMatrix);
+
+	const std::vector<unsigned int>& Order() const { return order; }
+
+	// adds how far any point may have moved, e.g. max speed * step
+	void Moved(float distance) { motion += distance; }
+	bool NeedsSort(const glm::mat4& viewMatrix) const;
+
+	// null sorts on the calling thread only
+	void SetThreadPool(ThreadPool* pool) { threads = pool; }
+
+	bool wideKeys = false;				// 32 bit keys, four passes instead of two
+	unsigned int parallelCount = 65536;	// smaller sorts stay on the calling thread
+	float sortDistance = 1.0f;			// world units of camera or point movement
+	float sortTurn = 0.999f;			// cosine of the camera turn
+
+	// points per job
+	static const unsigned int CHUNK_SIZE = 16384;
+	static const unsigned int RADIX = 256;
+
+private:
+	std::vector<float> depth;
+	std::vector<unsigned int> keys, keysScratch;
+	std::vector<unsigned int> order, orderScratch;
+	std::vector<unsigned int> offsets;		// RADIX per chunk, counts then scatter positions
+	std::vector<float> chunkNear, chunkFar;
+
+	ThreadPool* threads = nullptr;
+
+	// state at the last Sort
+	bool sorted = false;
+	float motion = 0.0f;
+	glm::vec3 sortCamera;
+	glm::vec3 sortForward;
+
+	void forChunks(unsigned int count, const std::function<void(unsigned int, unsigned int, unsigned int)>& job);
+	bool radixPass(unsigned int count, unsigned int shift);
+};
+
+#endif // !DEPTH_SORTER_H
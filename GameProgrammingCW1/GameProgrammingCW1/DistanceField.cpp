@@ -0,0 +1,116 @@
+#include "DistanceField.h"
+#include <cmath>
+#include <algorithm>
+
+DistanceField::DistanceField()
+{
+}
+
+DistanceField::~DistanceField()
+{
+}
+
+void DistanceField::Build(const std::vector<std::vector<int>>& grid, glm::vec3 origin, int samplesPerCell, float maxDistance)
+{
+	int rows = grid.size();
+	int columns = rows > 0 ? grid[0].size() : 0;
+
+	this->maxDistance = maxDistance;
+	spacing = 1.0f / samplesPerCell;
+	minX = origin.x - 0.5f - maxDistance;
+	minZ = origin.z - 0.5f - maxDistance;
+	width = (int)std::ceil((columns + 2 * maxDistance) / spacing) + 1;
+	height = (int)std::ceil((rows + 2 * maxDistance) / spacing) + 1;
+
+	distance.assign(width * height, maxDistance);
+	gradientX.assign(width * height, 0.0f);
+	gradientZ.assign(width * height, 0.0f);
+
+	// only walls within maxDistance of a sample can be the nearest one
+	int reach = (int)std::ceil(maxDistance) + 1;
+
+	for (int sz = 0; sz < height; sz++)
+	{
+		for (int sx = 0; sx < width; sx++)
+		{
+			float x = minX + sx * spacing;
+			float z = minZ + sz * spacing;
+			int column = (int)std::floor(x - origin.x + 0.5f);
+			int row = (int)std::floor(z - origin.z + 0.5f);
+
+			float nearest = maxDistance;
+			for (int i = std::max(row - reach, 0); i <= std::min(row + reach, rows - 1); i++)
+			{
+				for (int j = std::max(column - reach, 0); j <= std::min(column + reach, columns - 1); j++)
+				{
+					if (grid[i][j] != 1)
+						continue;
+
+					// distance to a unit box, negative inside
+					float dx = std::fabs(x - (origin.x + j)) - 0.5f;
+					float dz = std::fabs(z - (origin.z + i)) - 0.5f;
+					float outside = std::sqrt(std::max(dx, 0.0f) * std::max(dx, 0.0f) + std::max(dz, 0.0f) * std::max(dz, 0.0f));
+					float inside = std::min(std::max(dx, dz), 0.0f);
+					nearest = std::min(nearest, outside + inside);
+				}
+			}
+			distance[sz * width + sx] = nearest;
+		}
+	}
+
+	// central differences, one sided on the border
+	for (int sz = 0; sz < height; sz++)
+	{
+		for (int sx = 0; sx < width; sx++)
+		{
+			int x0 = std::max(sx - 1, 0), x1 = std::min(sx + 1, width - 1);
+			int z0 = std::max(sz - 1, 0), z1 = std::min(sz + 1, height - 1);
+			float gx = (distance[sz * width + x1] - distance[sz * width + x0]) / ((x1 - x0) * spacing);
+			float gz = (distance[z1 * width + sx] - distance[z0 * width + sx]) / ((z1 - z0) * spacing);
+			float length = std::sqrt(gx * gx + gz * gz);
+			if (length > 0.0f)
+			{
+				gradientX[sz * width + sx] = gx / length;
+				gradientZ[sz * width + sx] = gz / length;
+			}
+		}
+	}
+}
+
+void DistanceField::Sample(float x, float z, float& outDistance, float& outGradientX, float& outGradientZ) const
+{
+	float fx = (x - minX) / spacing;
+	float fz = (z - minZ) / spacing;
+	if (distance.empty() || fx < 0.0f || fz < 0.0f || fx >= width - 1 || fz >= height - 1)
+	{
+		outDistance = maxDistance;
+		outGradientX = 0.0f;
+		outGradientZ = 0.0f;
+		return;
+	}
+
+	int ix = (int)fx;
+	int iz = (int)fz;
+	float tx = fx - ix;
+	float tz = fz - iz;
+	int i00 = iz * width + ix;
+	int i10 = i00 + 1;
+	int i01 = i00 + width;
+	int i11 = i01 + 1;
+
+	float w00 = (1 - tx) * (1 - tz);
+	float w10 = tx * (1 - tz);
+	float w01 = (1 - tx) * tz;
+	float w11 = tx * tz;
+
+	outDistance = distance[i00] * w00 + distance[i10] * w10 + distance[i01] * w01 + distance[i11] * w11;
+	outGradientX = gradientX[i00] * w00 + gradientX[i10] * w10 + gradientX[i01] * w01 + gradientX[i11] * w11;
+	outGradientZ = gradientZ[i00] * w00 + gradientZ[i10] * w10 + gradientZ[i01] * w01 + gradientZ[i11] * w11;
+}
+
+float DistanceField::Distance(glm::vec3 position) const
+{
+	float d, gx, gz;
+	Sample(position.x, position.z, d, gx, gz);
+	return d;
+}
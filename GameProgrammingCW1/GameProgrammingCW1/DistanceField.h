@@ -0,0 +1,43 @@
+#ifndef DISTANCE_FIELD_H
+#define DISTANCE_FIELD_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Signed distance to the walls of a grid map on the x/z plane, sampled once at
+// load time together with its gradient.
+// Wall cells are unit boxes centred on (column, row) + origin like the wall
+// bodies built in Source.cpp. Lookups are a bilinear sample, their cost does
+// not depend on how many walls the map has.
+class DistanceField
+{
+public:
+	DistanceField();
+	~DistanceField();
+
+	// samplesPerCell samples along each cell side, the field covers the map plus
+	// maxDistance on every side and is clamped to maxDistance
+	void Build(const std::vector<std::vector<int>>& grid, glm::vec3 origin, int samplesPerCell, float maxDistance);
+
+	// distance to the nearest wall surface (negative inside a wall) and the
+	// normalized direction away from it, zero outside the field
+	void Sample(float x, float z, float& distance, float& gradientX, float& gradientZ) const;
+	float Distance(glm::vec3 position) const;
+
+	bool Empty() const { return distance.empty(); }
+
+private:
+	int width = 0;		// samples along x
+	int height = 0;		// samples along z
+	float minX = 0.0f;
+	float minZ = 0.0f;
+	float spacing = 1.0f;
+	float maxDistance = 0.0f;
+
+	std::vector<float> distance;
+	std::vector<float> gradientX;
+	std::vector<float> gradientZ;
+};
+
+#endif // !DISTANCE_FIELD_H
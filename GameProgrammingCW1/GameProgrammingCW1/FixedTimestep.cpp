@@ -0,0 +1,32 @@
+#include "FixedTimestep.h"
+
+FixedTimestep::FixedTimestep(float stepsPerSecond, int maxSteps) : step(1.0f / stepsPerSecond), maxSteps(maxSteps)
+{
+}
+
+FixedTimestep::~FixedTimestep()
+{
+}
+
+void FixedTimestep::SetRate(float stepsPerSecond)
+{
+	step = 1.0f / stepsPerSecond;
+}
+
+int FixedTimestep::Advance(float frameTime)
+{
+	accumulator += frameTime;
+
+	int steps = (int)(accumulator / step);
+	if (steps > maxSteps)
+	{
+		steps = maxSteps;
+		accumulator = 0.0f;
+		return steps;
+	}
+
+	accumulator -= steps * step;
+	if (accumulator < 0.0f)
+		accumulator = 0.0f;
+	return steps;
+}
@@ -0,0 +1,29 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// Turns variable frame times into a whole number of fixed simulation steps.
+// The time left over is kept for the next frame and Alpha says how far the
+// frame is between the last two steps, to interpolate what gets drawn.
+// A frame never runs more than maxSteps steps, time beyond that is dropped so
+// a slow frame cannot snowball into slower ones.
+class FixedTimestep
+{
+public:
+	FixedTimestep(float stepsPerSecond = 60.0f, int maxSteps = 5);
+	~FixedTimestep();
+
+	void SetRate(float stepsPerSecond);
+
+	// adds the frame time, returns how many steps to run this frame
+	int Advance(float frameTime);
+
+	float Step() const { return step; }
+	float Alpha() const { return accumulator / step; }
+
+private:
+	float step;
+	int maxSteps;
+	float accumulator = 0.0f;
+};
+
+#endif // !FIXED_TIMESTEP_H
@@ -0,0 +1,462 @@
+#include "Flock.h"
+#include "SimdFloat.h"
+#include <algorithm>
+
+static float sumArray(const float* values, unsigned int count)
+{
+	SimdFloat acc(0.0f);
+	unsigned int i = 0;
+	for (; i + SimdFloat::Width <= count; i += SimdFloat::Width)
+	{
+		acc += SimdFloat::Load(&values[i]);
+	}
+	float total = Sum(acc);
+	for (; i < count; i++)
+	{
+		total += values[i];
+	}
+	return total;
+}
+
+static void boundsArray(const float* values, unsigned int count, float& low, float& high)
+{
+	unsigned int i = 0;
+	low = values[0];
+	high = values[0];
+	if (count >= (unsigned int)SimdFloat::Width)
+	{
+		SimdFloat lowLanes = SimdFloat::Load(&values[0]);
+		SimdFloat highLanes = lowLanes;
+		for (i = SimdFloat::Width; i + SimdFloat::Width <= count; i += SimdFloat::Width)
+		{
+			SimdFloat v = SimdFloat::Load(&values[i]);
+			lowLanes = Min(lowLanes, v);
+			highLanes = Max(highLanes, v);
+		}
+		float lanes[SimdFloat::Width];
+		lowLanes.Store(lanes);
+		for (int l = 0; l < SimdFloat::Width; l++) low = lanes[l] < low ? lanes[l] : low;
+		highLanes.Store(lanes);
+		for (int l = 0; l < SimdFloat::Width; l++) high = lanes[l] > high ? lanes[l] : high;
+	}
+	for (; i < count; i++)
+	{
+		low = values[i] < low ? values[i] : low;
+		high = values[i] > high ? values[i] : high;
+	}
+}
+
+void FlockState::Add(glm::vec3 position)
+{
+	positionX.push_back(position.x);
+	positionY.push_back(position.y);
+	positionZ.push_back(position.z);
+	velocityX.push_back(0.0f);
+	velocityY.push_back(0.0f);
+	velocityZ.push_back(0.0f);
+	forceX.push_back(0.0f);
+	forceY.push_back(0.0f);
+	forceZ.push_back(0.0f);
+	colliding.push_back(0.0f);
+}
+
+void FlockState::Clear()
+{
+	positionX.clear(); positionY.clear(); positionZ.clear();
+	velocityX.clear(); velocityY.clear(); velocityZ.clear();
+	forceX.clear(); forceY.clear(); forceZ.clear();
+	colliding.clear();
+}
+
+void FlockState::Save(Snapshot& snapshot) const
+{
+	snapshot.Write(positionX); snapshot.Write(positionY); snapshot.Write(positionZ);
+	snapshot.Write(velocityX); snapshot.Write(velocityY); snapshot.Write(velocityZ);
+	snapshot.Write(forceX); snapshot.Write(forceY); snapshot.Write(forceZ);
+	snapshot.Write(colliding);
+}
+
+void FlockState::Load(SnapshotReader& reader)
+{
+	reader.Read(positionX); reader.Read(positionY); reader.Read(positionZ);
+	reader.Read(velocityX); reader.Read(velocityY); reader.Read(velocityZ);
+	reader.Read(forceX); reader.Read(forceY); reader.Read(forceZ);
+	reader.Read(colliding);
+}
+
+Flock::Flock() : grid(params.separationRadius)
+{
+}
+
+Flock::~Flock()
+{
+}
+
+void Flock::Add(glm::vec3 position)
+{
+	states[0].Add(position);
+	states[1].Add(position);
+	steerX.push_back(0.0f);
+	steerY.push_back(0.0f);
+	steerZ.push_back(0.0f);
+	count++;
+}
+
+void Flock::Clear()
+{
+	states[0].Clear();
+	states[1].Clear();
+	steerX.clear(); steerY.clear(); steerZ.clear();
+	count = 0;
+}
+
+void Flock::Save(Snapshot& snapshot) const
+{
+	snapshot.Write(count);
+	snapshot.Write(current);
+	snapshot.Write(boundsMin);
+	snapshot.Write(boundsMax);
+	states[0].Save(snapshot);
+	states[1].Save(snapshot);
+}
+
+void Flock::Load(SnapshotReader& reader)
+{
+	reader.Read(count);
+	reader.Read(current);
+	reader.Read(boundsMin);
+	reader.Read(boundsMax);
+	states[0].Load(reader);
+	states[1].Load(reader);
+	steerX.resize(count); steerY.resize(count); steerZ.resize(count);
+}
+
+glm::vec3 Flock::InterpolatedPosition(unsigned int i, float alpha) const
+{
+	const FlockState& previous = PreviousState();
+	const FlockState& state = State();
+	return glm::mix(
+		glm::vec3(previous.positionX[i], previous.positionY[i], previous.positionZ[i]),
+		glm::vec3(state.positionX[i], state.positionY[i], state.positionZ[i]),
+		alpha);
+}
+
+void Flock::Step(glm::vec3 target, float deltaTime)
+{
+	if (count == 0)
+		return;
+
+	glm::vec3 center;
+	glm::vec3 averageVelocity;
+	reduce(center, averageVelocity);
+	glm::vec3 alignment = averageVelocity / params.alignmentFactor;
+
+	bool nearest = params.neighbourMode == NeighbourMode::KNearest;
+	if (nearest)
+	{
+		buildTree();
+	}
+	else
+	{
+		buildGrid();
+	}
+
+	// every chunk reads the previous state and writes its own slice of the next
+	forEachChunk([&](unsigned int begin, unsigned int end)
+	{
+		applyGlobalRules(begin, end, target, center, alignment);
+		if (nearest)
+		{
+			applySeparationNearest(begin, end);
+		}
+		else
+		{
+			applySeparation(begin, end);
+		}
+		applyObstacleField(begin, end);
+		integrate(begin, end, deltaTime);
+		resolveObstacles(begin, end);
+	});
+
+	current = 1 - current;
+}
+
+void Flock::forEachChunk(const std::function<void(unsigned int, unsigned int)>& job)
+{
+	if (threads != nullptr)
+	{
+		threads->ParallelFor(count, CHUNK_SIZE, job);
+		return;
+	}
+
+	for (unsigned int begin = 0; begin < count; begin += CHUNK_SIZE)
+	{
+		job(begin, begin + CHUNK_SIZE < count ? begin + CHUNK_SIZE : count);
+	}
+}
+
+void Flock::reduce(glm::vec3& center, glm::vec3& averageVelocity)
+{
+	const FlockState& state = states[current];
+
+	// partial sums per chunk, added up in chunk order so the result is the
+	// same whichever thread summed which chunk
+	unsigned int chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	chunkPositionSums.resize(chunkCount);
+	chunkVelocitySums.resize(chunkCount);
+	chunkBoundsMin.resize(chunkCount);
+	chunkBoundsMax.resize(chunkCount);
+
+	forEachChunk([&](unsigned int begin, unsigned int end)
+	{
+		unsigned int n = end - begin;
+		chunkPositionSums[begin / CHUNK_SIZE] = glm::vec3(
+			sumArray(&state.positionX[begin], n), sumArray(&state.positionY[begin], n), sumArray(&state.positionZ[begin], n));
+		chunkVelocitySums[begin / CHUNK_SIZE] = glm::vec3(
+			sumArray(&state.velocityX[begin], n), sumArray(&state.velocityY[begin], n), sumArray(&state.velocityZ[begin], n));
+
+		glm::vec3& low = chunkBoundsMin[begin / CHUNK_SIZE];
+		glm::vec3& high = chunkBoundsMax[begin / CHUNK_SIZE];
+		boundsArray(&state.positionX[begin], n, low.x, high.x);
+		boundsArray(&state.positionY[begin], n, low.y, high.y);
+		boundsArray(&state.positionZ[begin], n, low.z, high.z);
+	});
+
+	glm::vec3 positionSum(0.0f);
+	glm::vec3 velocitySum(0.0f);
+	boundsMin = chunkBoundsMin[0];
+	boundsMax = chunkBoundsMax[0];
+	for (unsigned int c = 0; c < chunkCount; c++)
+	{
+		positionSum += chunkPositionSums[c];
+		velocitySum += chunkVelocitySums[c];
+		boundsMin = glm::min(boundsMin, chunkBoundsMin[c]);
+		boundsMax = glm::max(boundsMax, chunkBoundsMax[c]);
+	}
+	center = positionSum / (float)count;
+	averageVelocity = velocitySum / (float)count;
+}
+
+void Flock::buildGrid()
+{
+	const FlockState& state = states[current];
+
+	if (grid.CellSize() != params.separationRadius)
+	{
+		grid = SpatialGrid(params.separationRadius);
+	}
+	grid.Build(&state.positionX[0], &state.positionY[0], &state.positionZ[0], count);
+
+	// copy positions in cell order so each neighbour cell is a contiguous run
+	const std::vector<unsigned int>& entries = grid.Entries();
+	sortedX.resize(count);
+	sortedY.resize(count);
+	sortedZ.resize(count);
+	forEachChunk([&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int k = begin; k < end; k++)
+		{
+			sortedX[k] = state.positionX[entries[k]];
+			sortedY[k] = state.positionY[entries[k]];
+			sortedZ[k] = state.positionZ[entries[k]];
+		}
+	});
+}
+
+void Flock::buildTree()
+{
+	const FlockState& state = states[current];
+	tree.Build(&state.positionX[0], &state.positionY[0], &state.positionZ[0], count);
+
+	neighbours.resize(count * queryCount());
+	neighbourCounts.resize(count);
+}
+
+unsigned int Flock::queryCount() const
+{
+	// the boid finds itself first, ask for one more
+	unsigned int k = params.neighbourCount + 1;
+	return k < KdTree::MAX_K ? k : KdTree::MAX_K;
+}
+
+void Flock::applyGlobalRules(unsigned int begin, unsigned int end, glm::vec3 target, glm::vec3 center, glm::vec3 alignment)
+{
+	const FlockState& state = states[current];
+
+	float invCohesion = 1.0f / params.cohesionFactor;
+	float invTarget = 1.0f / params.targetFactor;
+
+	// cohesion, controller, alignment and ground, per boid only the boid's own
+	// position is read
+	RunKernel(begin, end, [&](unsigned int i, auto lane)
+	{
+		typedef decltype(lane) F;
+		F px = F::Load(&state.positionX[i]);
+		F py = F::Load(&state.positionY[i]);
+		F pz = F::Load(&state.positionZ[i]);
+
+		F sx = F(alignment.x) + (F(center.x) - px) * F(invCohesion) + (F(target.x) - px) * F(invTarget);
+		F sy = F(alignment.y) + (F(center.y) - py) * F(invCohesion) + (F(target.y) - py) * F(invTarget);
+		F sz = F(alignment.z) + (F(center.z) - pz) * F(invCohesion) + (F(target.z) - pz) * F(invTarget);
+
+		F ground = Mask(py < F(params.minHeight), F(1.0f));
+		sx += ground;
+		sy += ground;
+		sz += ground;
+
+		sx.Store(&steerX[i]);
+		sy.Store(&steerY[i]);
+		sz.Store(&steerZ[i]);
+	});
+}
+
+void Flock::applySeparation(unsigned int begin, unsigned int end)
+{
+	const FlockState& state = states[current];
+	float radius2 = params.separationRadius * params.separationRadius;
+
+	// the boid itself is in range but adds a zero offset, no need to skip it
+	for (unsigned int i = begin; i < end; i++)
+	{
+		glm::vec3 position(state.positionX[i], state.positionY[i], state.positionZ[i]);
+		SimdFloat accX(0.0f), accY(0.0f), accZ(0.0f);
+		glm::vec3 tail(0.0f);
+
+		grid.ForEachNeighbourRange(position, [&](unsigned int rangeBegin, unsigned int rangeEnd)
+		{
+			unsigned int k = rangeBegin;
+			for (; k + SimdFloat::Width <= rangeEnd; k += SimdFloat::Width)
+			{
+				SimdFloat dx = SimdFloat(position.x) - SimdFloat::Load(&sortedX[k]);
+				SimdFloat dy = SimdFloat(position.y) - SimdFloat::Load(&sortedY[k]);
+				SimdFloat dz = SimdFloat(position.z) - SimdFloat::Load(&sortedZ[k]);
+				auto near = (dx * dx + dy * dy + dz * dz) < SimdFloat(radius2);
+				accX += Mask(near, dx);
+				accY += Mask(near, dy);
+				accZ += Mask(near, dz);
+			}
+			for (; k < rangeEnd; k++)
+			{
+				glm::vec3 offset = position - glm::vec3(sortedX[k], sortedY[k], sortedZ[k]);
+				if (glm::dot(offset, offset) < radius2)
+				{
+					tail += offset;
+				}
+			}
+		});
+
+		steerX[i] += Sum(accX) + tail.x;
+		steerY[i] += Sum(accY) + tail.y;
+		steerZ[i] += Sum(accZ) + tail.z;
+	}
+}
+
+void Flock::applySeparationNearest(unsigned int begin, unsigned int end)
+{
+	const FlockState& state = states[current];
+	unsigned int k = queryCount();
+
+	// each boid looks at a bounded number of neighbours however dense the
+	// flock gets, the boid itself adds a zero offset
+	tree.QueryBatch(begin, end, k, params.separationRadius, &neighbours[0], &neighbourCounts[0]);
+
+	for (unsigned int i = begin; i < end; i++)
+	{
+		glm::vec3 position(state.positionX[i], state.positionY[i], state.positionZ[i]);
+		glm::vec3 steer(0.0f);
+		for (unsigned int n = 0; n < neighbourCounts[i]; n++)
+		{
+			unsigned int j = neighbours[i * k + n];
+			steer += position - glm::vec3(state.positionX[j], state.positionY[j], state.positionZ[j]);
+		}
+		steerX[i] += steer.x;
+		steerY[i] += steer.y;
+		steerZ[i] += steer.z;
+	}
+}
+
+void Flock::applyObstacleField(unsigned int begin, unsigned int end)
+{
+	if (obstacleField == nullptr)
+		return;
+
+	const FlockState& state = states[current];
+	float avoidDistance = params.obstacleAvoidDistance;
+
+	// push away from the nearest wall, harder the closer the boid gets
+	for (unsigned int i = begin; i < end; i++)
+	{
+		float distance, gradientX, gradientZ;
+		obstacleField->Sample(state.positionX[i], state.positionZ[i], distance, gradientX, gradientZ);
+		if (distance < avoidDistance)
+		{
+			steerX[i] += gradientX * (avoidDistance - distance);
+			steerZ[i] += gradientZ * (avoidDistance - distance);
+		}
+	}
+}
+
+void Flock::integrate(unsigned int begin, unsigned int end, float deltaTime)
+{
+	const FlockState& previous = states[current];
+	FlockState& next = states[1 - current];
+
+	// same as Body::Update for a boid: add steering, clamp to top speed, move,
+	// and drop the obstacle push once the boid stopped colliding
+	RunKernel(begin, end, [&](unsigned int i, auto lane)
+	{
+		typedef decltype(lane) F;
+		F dt(deltaTime);
+		F top(topSpeed);
+		F bottom(-topSpeed);
+		F zero(0.0f);
+
+		F vx = Min(Max(F::Load(&previous.velocityX[i]) + F::Load(&steerX[i]), bottom), top);
+		F vy = Min(Max(F::Load(&previous.velocityY[i]) + F::Load(&steerY[i]), bottom), top);
+		F vz = Min(Max(F::Load(&previous.velocityZ[i]) + F::Load(&steerZ[i]), bottom), top);
+
+		F fx = F::Load(&previous.forceX[i]);
+		F fy = F::Load(&previous.forceY[i]);
+		F fz = F::Load(&previous.forceZ[i]);
+
+		(F::Load(&previous.positionX[i]) + (vx + fx) * dt).Store(&next.positionX[i]);
+		(F::Load(&previous.positionY[i]) + (vy + fy) * dt).Store(&next.positionY[i]);
+		(F::Load(&previous.positionZ[i]) + (vz + fz) * dt).Store(&next.positionZ[i]);
+
+		vx.Store(&next.velocityX[i]);
+		vy.Store(&next.velocityY[i]);
+		vz.Store(&next.velocityZ[i]);
+
+		auto keep = zero < F::Load(&previous.colliding[i]);
+		Mask(keep, fx).Store(&next.forceX[i]);
+		Mask(keep, fy).Store(&next.forceY[i]);
+		Mask(keep, fz).Store(&next.forceZ[i]);
+	});
+}
+
+void Flock::resolveObstacles(unsigned int begin, unsigned int end)
+{
+	FlockState& next = states[1 - current];
+	if (obstacleField == nullptr)
+	{
+		// the buffer still holds the flags from two ticks ago
+		std::fill(next.colliding.begin() + begin, next.colliding.begin() + end, 0.0f);
+		return;
+	}
+
+	float radius = glm::min(boidScale.x, boidScale.z) / 2;
+
+	// a boid closer to a wall than its half size overlaps it and is pushed
+	// along its velocity, like CheckCollision
+	for (unsigned int i = begin; i < end; i++)
+	{
+		bool hit = obstacleField->Distance(glm::vec3(next.positionX[i], 0.0f, next.positionZ[i])) < radius;
+		next.colliding[i] = hit ? 1.0f : 0.0f;
+		if (hit)
+		{
+			next.forceX[i] = next.velocityX[i] * 1.5f;
+			next.forceY[i] = next.velocityY[i] * 1.5f;
+			next.forceZ[i] = next.velocityZ[i] * 1.5f;
+		}
+	}
+}
@@ -0,0 +1,115 @@
+#ifndef FLOCK_H
+#define FLOCK_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "SpatialGrid.h"
+#include "KdTree.h"
+#include "DistanceField.h"
+#include "FlockRules.h"
+#include "ThreadPool.h"
+#include "Snapshot.h"
+
+// Boid state for one frame, structure of arrays.
+struct FlockState
+{
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> velocityX, velocityY, velocityZ;
+	std::vector<float> forceX, forceY, forceZ;		// obstacle push (Body::addedForce)
+	std::vector<float> colliding;					// 1.0 while overlapping an obstacle
+
+	void Add(glm::vec3 position);
+	void Clear();
+	void Save(Snapshot& snapshot) const;
+	void Load(SnapshotReader& reader);
+};
+
+// Boid storage laid out as structure of arrays, the rule and integration
+// kernels stream only the arrays they need and run on SimdFloat lanes.
+// Replaces one Body per boid: boids only need position, velocity and the
+// collision push.
+// State is double buffered: Step reads the previous frame and writes the next
+// one, so fixed size chunks of boids can be updated on any thread and the
+// result does not depend on the number of threads.
+class Flock
+{
+public:
+	Flock();
+	~Flock();
+
+	void Add(glm::vec3 position);
+	void Clear();
+
+	// boid state and bounds, not the params or obstacles
+	void Save(Snapshot& snapshot) const;
+	void Load(SnapshotReader& reader);
+
+	// static obstacles boids steer around and collide with, not owned
+	void SetObstacleField(const DistanceField* field) { obstacleField = field; }
+
+	// null runs the step on the calling thread only
+	void SetThreadPool(ThreadPool* pool) { threads = pool; }
+
+	// rules, integration and obstacle collision for every boid
+	void Step(glm::vec3 target, float deltaTime);
+
+	unsigned int Size() const { return count; }
+	const FlockState& State() const { return states[current]; }
+	// state before the last Step, used to interpolate between ticks
+	const FlockState& PreviousState() const { return states[1 - current]; }
+	glm::vec3 Position(unsigned int i) const { return glm::vec3(State().positionX[i], State().positionY[i], State().positionZ[i]); }
+	glm::vec3 Velocity(unsigned int i) const { return glm::vec3(State().velocityX[i], State().velocityY[i], State().velocityZ[i]); }
+	glm::vec3 InterpolatedPosition(unsigned int i, float alpha) const;
+
+	// box around the boids at the start of the last Step
+	glm::vec3 BoundsMin() const { return boundsMin; }
+	glm::vec3 BoundsMax() const { return boundsMax; }
+
+	BoidParams params;
+	float topSpeed = 0.2f;
+	glm::vec3 boidScale = glm::vec3(1.0f);
+
+	// boids per job, a multiple of every SimdFloat width
+	static const unsigned int CHUNK_SIZE = 1024;
+
+private:
+	unsigned int count = 0;
+
+	FlockState states[2];
+	unsigned int current = 0;
+
+	ThreadPool* threads = nullptr;
+
+	SpatialGrid grid;
+	std::vector<float> sortedX, sortedY, sortedZ;	// positions in grid entry order
+
+	KdTree tree;
+	std::vector<unsigned int> neighbours;			// KNearest results, queryCount per boid
+	std::vector<unsigned int> neighbourCounts;
+	std::vector<float> steerX, steerY, steerZ;		// rules output, per boid scratch
+	std::vector<glm::vec3> chunkPositionSums;
+	std::vector<glm::vec3> chunkVelocitySums;
+	std::vector<glm::vec3> chunkBoundsMin;
+	std::vector<glm::vec3> chunkBoundsMax;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+
+	const DistanceField* obstacleField = nullptr;
+
+	void forEachChunk(const std::function<void(unsigned int, unsigned int)>& job);
+
+	void reduce(glm::vec3& center, glm::vec3& averageVelocity);
+	void buildGrid();
+	void buildTree();
+	unsigned int queryCount() const;
+	void applyGlobalRules(unsigned int begin, unsigned int end, glm::vec3 target, glm::vec3 center, glm::vec3 alignment);
+	void applySeparation(unsigned int begin, unsigned int end);
+	void applySeparationNearest(unsigned int begin, unsigned int end);
+	void applyObstacleField(unsigned int begin, unsigned int end);
+	void integrate(unsigned int begin, unsigned int end, float deltaTime);
+	void resolveObstacles(unsigned int begin, unsigned int end);
+};
+
+#endif // !FLOCK_H
@@ -0,0 +1,197 @@
+#include "FlockManager.h"
+#include <algorithm>
+#include <chrono>
+
+// frustum planes (a, b, c, d) from a view-projection matrix, inside is positive
+static void extractPlanes(const glm::mat4& m, glm::vec4 planes[6])
+{
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	planes[0] = row3 + row0;	// left
+	planes[1] = row3 - row0;	// right
+	planes[2] = row3 + row1;	// bottom
+	planes[3] = row3 - row1;	// top
+	planes[4] = row3 + row2;	// near
+	planes[5] = row3 - row2;	// far
+	for (int p = 0; p < 6; p++)
+	{
+		planes[p] /= glm::length(glm::vec3(planes[p]));
+	}
+}
+
+static bool sphereVisible(const glm::vec4 planes[6], glm::vec3 center, float radius)
+{
+	for (int p = 0; p < 6; p++)
+	{
+		if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+FlockManager::FlockManager()
+{
+	levels.push_back({ 25.0f, 0.0f });
+	levels.push_back({ 60.0f, 1.0f / 30.0f });
+	levels.push_back({ 150.0f, 1.0f / 10.0f });
+}
+
+FlockManager::~FlockManager()
+{
+}
+
+unsigned int FlockManager::AddFlock()
+{
+	ManagedFlock managed;
+	managed.flock.reset(new Flock());
+	managed.flock->SetThreadPool(threads);
+	managed.target = glm::vec3(0.0f);
+	managed.sinceTick = 0.0f;
+	managed.tickGap = 0.0f;
+	managed.interval = 0.0f;
+	managed.cost = 0.0f;
+	managed.everTicked = false;
+	flocks.push_back(std::move(managed));
+	return flocks.size() - 1;
+}
+
+void FlockManager::SetThreadPool(ThreadPool* pool)
+{
+	threads = pool;
+	for (ManagedFlock& managed : flocks)
+	{
+		managed.flock->SetThreadPool(pool);
+	}
+}
+
+void FlockManager::BeginFrame()
+{
+	tickedThisFrame = 0;
+	spentThisFrame = 0.0f;
+}
+
+void FlockManager::Update(float deltaTime, glm::vec3 cameraPosition, const glm::mat4& viewProjection)
+{
+	glm::vec4 planes[6];
+	extractPlanes(viewProjection, planes);
+	lastDeltaTime = deltaTime;
+
+	// collect the flocks whose interval has passed
+	due.clear();
+	for (unsigned int id = 0; id < flocks.size(); id++)
+	{
+		ManagedFlock& managed = flocks[id];
+		managed.sinceTick += deltaTime;
+		managed.interval = chooseInterval(managed, cameraPosition, planes);
+		if (!managed.everTicked || managed.sinceTick >= managed.interval)
+		{
+			due.push_back(id);
+		}
+	}
+
+	// most overdue first, relative to their own interval
+	std::sort(due.begin(), due.end(), [this](unsigned int a, unsigned int b)
+	{
+		const ManagedFlock& fa = flocks[a];
+		const ManagedFlock& fb = flocks[b];
+		return fa.sinceTick * std::max(fb.interval, 1e-3f) > fb.sinceTick * std::max(fa.interval, 1e-3f);
+	});
+
+	// spend what is left of the frame budget, the first flock of a frame always
+	// runs so nothing starves
+	ticked = 0;
+	for (unsigned int id : due)
+	{
+		ManagedFlock& managed = flocks[id];
+		if (tickedThisFrame > 0 && spentThisFrame + managed.cost > budgetMilliseconds)
+			continue;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		tick(managed);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		float cost = std::chrono::duration<float, std::milli>(end - start).count();
+		managed.cost = managed.everTicked ? managed.cost * 0.8f + cost * 0.2f : cost;
+		managed.everTicked = true;
+		spentThisFrame += cost;
+		tickedThisFrame++;
+		ticked++;
+	}
+}
+
+glm::vec3 FlockManager::Position(unsigned int id, unsigned int boid, float stepAlpha) const
+{
+	const ManagedFlock& managed = flocks[id];
+
+	// flocks ticking every Update are drawn between their last two ticks like
+	// any fixed step state, the others are one tick behind, moving from the
+	// previous tick to the last one (and a step behind that with stepAlpha)
+	float alpha = stepAlpha;
+	if (managed.interval > 0.0f && managed.tickGap > 0.0f)
+	{
+		float drawnSince = managed.sinceTick - (1.0f - stepAlpha) * lastDeltaTime;
+		alpha = glm::clamp(drawnSince / managed.tickGap, 0.0f, 1.0f);
+	}
+	return managed.flock->InterpolatedPosition(boid, alpha);
+}
+
+void FlockManager::Save(Snapshot& snapshot) const
+{
+	snapshot.Write(lastDeltaTime);
+	for (const ManagedFlock& managed : flocks)
+	{
+		snapshot.Write(managed.target);
+		snapshot.Write(managed.sinceTick);
+		snapshot.Write(managed.tickGap);
+		snapshot.Write(managed.interval);
+		snapshot.Write(managed.everTicked);
+		managed.flock->Save(snapshot);
+	}
+}
+
+void FlockManager::Load(SnapshotReader& reader)
+{
+	reader.Read(lastDeltaTime);
+	for (ManagedFlock& managed : flocks)
+	{
+		reader.Read(managed.target);
+		reader.Read(managed.sinceTick);
+		reader.Read(managed.tickGap);
+		reader.Read(managed.interval);
+		reader.Read(managed.everTicked);
+		managed.flock->Load(reader);
+	}
+}
+
+float FlockManager::chooseInterval(const ManagedFlock& managed, glm::vec3 cameraPosition, const glm::vec4 planes[6]) const
+{
+	if (!managed.everTicked)
+		return 0.0f;
+
+	glm::vec3 low = managed.flock->BoundsMin();
+	glm::vec3 high = managed.flock->BoundsMax();
+	glm::vec3 center = (low + high) * 0.5f;
+	float radius = glm::length(high - low) * 0.5f + 1.0f;
+
+	if (!sphereVisible(planes, center, radius))
+		return offscreenInterval;
+
+	float distance = std::max(glm::distance(cameraPosition, center) - radius, 0.0f);
+	for (const FlockLevel& level : levels)
+	{
+		if (distance < level.maxDistance)
+			return level.tickInterval;
+	}
+	return farInterval;
+}
+
+void FlockManager::tick(ManagedFlock& managed)
+{
+	float step = std::min(managed.sinceTick, maxTickTime);
+	managed.flock->Step(managed.target, step);
+	managed.tickGap = managed.sinceTick;
+	managed.sinceTick = 0.0f;
+}
@@ -0,0 +1,86 @@
+#ifndef FLOCK_MANAGER_H
+#define FLOCK_MANAGER_H
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "Flock.h"
+#include "ThreadPool.h"
+
+// update rate for flocks closer to the camera than maxDistance
+struct FlockLevel
+{
+	float maxDistance;
+	float tickInterval;	// seconds between ticks, 0 = every frame
+};
+
+// Owns many independent flocks, each with its own target and parameters.
+// Distant and off-screen flocks tick less often and their boids are drawn
+// interpolated between the last two ticks. The flocks that are due each frame
+// are updated most overdue first until the frame budget is spent, whatever is
+// left over keeps its place and runs next frame.
+// The budget belongs to the frame, not to one Update: BeginFrame resets it and
+// every Update until the next BeginFrame (several when the fixed step catches
+// up) draws from what is left.
+class FlockManager
+{
+public:
+	FlockManager();
+	~FlockManager();
+
+	// returns the flock id
+	unsigned int AddFlock();
+	Flock& GetFlock(unsigned int id) { return *flocks[id].flock; }
+	unsigned int FlockCount() const { return flocks.size(); }
+
+	void SetTarget(unsigned int id, glm::vec3 target) { flocks[id].target = target; }
+	void SetThreadPool(ThreadPool* pool);
+
+	// call once per frame before its Updates
+	void BeginFrame();
+	void Update(float deltaTime, glm::vec3 cameraPosition, const glm::mat4& viewProjection);
+
+	// boid position to draw this frame, stepAlpha is how far the frame is
+	// between the last two Updates when they run at a fixed rate
+	glm::vec3 Position(unsigned int id, unsigned int boid, float stepAlpha = 1.0f) const;
+
+	// how many flocks ticked during the last Update
+	unsigned int TickedLastFrame() const { return ticked; }
+
+	// tick timing and every flock, loading expects the same flocks to exist
+	void Save(Snapshot& snapshot) const;
+	void Load(SnapshotReader& reader);
+
+	std::vector<FlockLevel> levels;		// sorted by maxDistance
+	float farInterval = 0.25f;			// beyond the last level
+	float offscreenInterval = 0.5f;
+	float maxTickTime = 0.5f;			// longest step a late flock is given
+	float budgetMilliseconds = 2.0f;	// per frame, shared by its Updates
+
+private:
+	struct ManagedFlock
+	{
+		std::unique_ptr<Flock> flock;	// owned, flocks never move once added
+		glm::vec3 target;
+		float sinceTick;	// seconds since the last tick
+		float tickGap;		// seconds between the last two ticks
+		float interval;		// wanted seconds between ticks
+		float cost;			// average milliseconds per tick
+		bool everTicked;
+	};
+
+	std::vector<ManagedFlock> flocks;
+	std::vector<unsigned int> due;
+	ThreadPool* threads = nullptr;
+	unsigned int ticked = 0;
+	unsigned int tickedThisFrame = 0;
+	float spentThisFrame = 0.0f;		// milliseconds
+	float lastDeltaTime = 0.0f;
+
+	float chooseInterval(const ManagedFlock& managed, glm::vec3 cameraPosition, const glm::vec4 planes[6]) const;
+	void tick(ManagedFlock& managed);
+};
+
+#endif // !FLOCK_MANAGER_H
@@ -0,0 +1,82 @@
+#include "FlockRules.h"
+
+FlockRules::FlockRules() : grid(params.separationRadius)
+{
+}
+
+FlockRules::~FlockRules()
+{
+}
+
+void FlockRules::Apply(std::vector<Body>& boids, const std::vector<Body>& obstacles, glm::vec3 target)
+{
+	unsigned int count = boids.size();
+	if (count == 0)
+		return;
+
+	// REDUCTIONS
+	// flock centre and average velocity, positions copied for the grid on the way
+	positionsX.resize(count);
+	positionsY.resize(count);
+	positionsZ.resize(count);
+
+	glm::vec3 center(0.0f);
+	glm::vec3 averageVelocity(0.0f);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const Body& boid = boids[i];
+		center += boid.position;
+		averageVelocity += boid.velocity;
+		positionsX[i] = boid.position.x;
+		positionsY[i] = boid.position.y;
+		positionsZ[i] = boid.position.z;
+	}
+	center /= (float)count;
+	averageVelocity /= (float)count;
+
+	// cell size has to follow the separation radius
+	if (grid.CellSize() != params.separationRadius)
+	{
+		grid = SpatialGrid(params.separationRadius);
+	}
+	grid.Build(&positionsX[0], &positionsY[0], &positionsZ[0], count);
+
+	// RULES
+	// the alignment term is the same for every boid
+	glm::vec3 alignment = averageVelocity / params.alignmentFactor;
+	float separationRadius = params.separationRadius;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		glm::vec3 position = boids[i].position;
+		glm::vec3 steer = alignment;
+
+		// rule 1 - cohesion and controller
+		steer += (center - position) / params.cohesionFactor;
+		steer += (target - position) / params.targetFactor;
+
+		// rule 2 - separation from ground, boids and obstacles
+		if (position.y < params.minHeight)
+		{
+			steer += 1.0f;
+		}
+
+		grid.ForEachNeighbour(position, [&](unsigned int j)
+		{
+			if (i != j && glm::distance(position, boids[j].position) < separationRadius)
+			{
+				steer += position - boids[j].position;
+			}
+		});
+
+		for (unsigned int j = 0; j < obstacles.size(); j++)
+		{
+			if (glm::distance(position, obstacles[j].position) < params.obstacleRadius)
+			{
+				steer += position - obstacles[j].position;
+			}
+		}
+
+		boids[i].boidVelocity += steer;
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef FLOCK_RULES_H
+#define FLOCK_RULES_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Body.h"
+#include "SpatialGrid.h"
+
+// where the separation rule takes its neighbours from
+enum class NeighbourMode
+{
+	Radius,		// every boid within separationRadius
+	KNearest	// the neighbourCount nearest boids within separationRadius (Flock only)
+};
+
+struct BoidParams
+{
+	float cohesionFactor = 100.0f;	// rule 1: pull towards the flock centre is divided by this
+	float targetFactor = 8.0f;		// rule 1: pull towards the controller is divided by this
+	float separationRadius = 1.0f;	// rule 2: boids closer than this push each other away
+	float obstacleRadius = 1.2f;	// rule 2: obstacles closer than this push the boid away
+	float obstacleAvoidDistance = 0.7f;	// rule 2: same for Flock, measured from the wall surface
+	float minHeight = 1.0f;			// rule 2: boids below this height are pushed up
+	float alignmentFactor = 8.0f;	// rule 3: average flock velocity is divided by this
+
+	NeighbourMode neighbourMode = NeighbourMode::Radius;
+	unsigned int neighbourCount = 7;
+};
+
+// Applies cohesion, separation and alignment to every boid and accumulates the
+// result into boidVelocity.
+// Global values (flock centre and average velocity) are reduced once per tick,
+// then all three rules run in a single pass over the boids.
+class FlockRules
+{
+public:
+	FlockRules();
+	~FlockRules();
+
+	void Apply(std::vector<Body>& boids, const std::vector<Body>& obstacles, glm::vec3 target);
+
+	BoidParams params;
+
+private:
+	SpatialGrid grid;
+
+	std::vector<float> positionsX;
+	std::vector<float> positionsY;
+	std::vector<float> positionsZ;
+};
+
+#endif // !FLOCK_RULES_H
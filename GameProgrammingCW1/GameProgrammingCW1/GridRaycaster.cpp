@@ -0,0 +1,382 @@
+#include "GridRaycaster.h"
+#include "SimdFloat.h"
+#include <algorithm>
+#include <cmath>
+
+// stands in for an infinite distance, stays finite when masked with 0
+static const float FAR = 1e30f;
+
+void RayBatch::Add(glm::vec3 origin, glm::vec3 direction, float maxDistance)
+{
+	float length = std::sqrt(direction.x * direction.x + direction.z * direction.z);
+	originX.push_back(origin.x);
+	originZ.push_back(origin.z);
+	directionX.push_back(length > 0.0f ? direction.x / length : 0.0f);
+	directionZ.push_back(length > 0.0f ? direction.z / length : 0.0f);
+	this->maxDistance.push_back(maxDistance);
+}
+
+void RayBatch::Clear()
+{
+	originX.clear(); originZ.clear();
+	directionX.clear(); directionZ.clear();
+	maxDistance.clear();
+}
+
+// narrows [enter, exit] to the part of the ray inside [0, size) on one axis
+static bool clipAxis(float start, float direction, float size, int axis, float& enter, float& exit, int& enterAxis)
+{
+	if (direction == 0.0f)
+		return start >= 0.0f && start < size;
+
+	float t0 = -start / direction;
+	float t1 = (size - start) / direction;
+	if (t0 > t1)
+		std::swap(t0, t1);
+	if (t0 > enter)
+	{
+		enter = t0;
+		enterAxis = axis;
+	}
+	exit = std::min(exit, t1);
+	return enter <= exit;
+}
+
+GridRaycaster::GridRaycaster()
+{
+}
+
+GridRaycaster::~GridRaycaster()
+{
+}
+
+bool GridRaycaster::Cast(glm::vec3 origin, glm::vec3 direction, float maxDistance, int& cell, float& distance, glm::vec3& normal) const
+{
+	float length = std::sqrt(direction.x * direction.x + direction.z * direction.z);
+	float directionX = length > 0.0f ? direction.x / length : 0.0f;
+	float directionZ = length > 0.0f ? direction.z / length : 0.0f;
+
+	RayState ray;
+	setup(origin.x, origin.z, directionX, directionZ, maxDistance, ray);
+	bool hit = walk(ray);
+	cell = hit ? (int)ray.row * tiles->Columns() + (int)ray.column : -1;
+	distance = hit ? ray.t : maxDistance;
+	normal = hit ? glm::vec3(ray.normalX, 0.0f, ray.normalZ) : glm::vec3(0.0f);
+	return hit;
+}
+
+void GridRaycaster::Cast(const RayBatch& rays, RayHits& hits) const
+{
+	unsigned int count = rays.Size();
+	hits.cell.resize(count);
+	hits.distance.resize(count);
+	hits.normalX.resize(count);
+	hits.normalZ.resize(count);
+
+	if (threads)
+	{
+		threads->ParallelFor(count, CHUNK_SIZE, [&](unsigned int begin, unsigned int end)
+		{
+			castRange(rays, hits, begin, end);
+		});
+	}
+	else
+	{
+		castRange(rays, hits, 0, count);
+	}
+}
+
+bool GridRaycaster::LineOfSight(glm::vec3 from, glm::vec3 to) const
+{
+	glm::vec3 direction(to.x - from.x, 0.0f, to.z - from.z);
+	int cell;
+	float distance;
+	glm::vec3 normal;
+	return !Cast(from, direction, glm::length(direction), cell, distance, normal);
+}
+
+void GridRaycaster::castRange(const RayBatch& rays, RayHits& hits, unsigned int begin, unsigned int end) const
+{
+	unsigned int i = begin;
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+	if (useSimd)
+	{
+		for (; i + 4 <= end; i += 4)
+		{
+			castPacket(rays, hits, i);
+		}
+	}
+#endif
+	for (; i < end; i++)
+	{
+		RayState ray;
+		setup(rays.originX[i], rays.originZ[i], rays.directionX[i], rays.directionZ[i], rays.maxDistance[i], ray);
+		bool hit = walk(ray);
+		hits.cell[i] = hit ? (int)ray.row * tiles->Columns() + (int)ray.column : -1;
+		hits.distance[i] = hit ? ray.t : rays.maxDistance[i];
+		hits.normalX[i] = hit ? ray.normalX : 0.0f;
+		hits.normalZ[i] = hit ? ray.normalZ : 0.0f;
+	}
+}
+
+void GridRaycaster::setup(float originX, float originZ, float directionX, float directionZ, float maxDistance, RayState& ray) const
+{
+	int columns = tiles ? tiles->Columns() : 0;
+	int rows = tiles ? tiles->Rows() : 0;
+	glm::vec3 origin = tiles ? tiles->Origin() : glm::vec3(0.0f);
+
+	// cell units, wall centres sit in the middle of their cell
+	float u = originX - origin.x + 0.5f;
+	float v = originZ - origin.z + 0.5f;
+
+	ray.t = 0.0f;
+	ray.limit = maxDistance;
+	ray.stepX = directionX > 0.0f ? 1.0f : -1.0f;
+	ray.stepZ = directionZ > 0.0f ? 1.0f : -1.0f;
+	ray.tDeltaX = directionX != 0.0f ? 1.0f / std::fabs(directionX) : FAR;
+	ray.tDeltaZ = directionZ != 0.0f ? 1.0f / std::fabs(directionZ) : FAR;
+	ray.tMaxX = FAR;
+	ray.tMaxZ = FAR;
+	ray.column = 0.0f;
+	ray.row = 0.0f;
+	ray.normalX = 0.0f;
+	ray.normalZ = 0.0f;
+	ray.running = 0.0f;
+
+	// rays starting outside are clipped to the map, rays that miss it never start
+	float enter = 0.0f;
+	float exit = maxDistance;
+	int enterAxis = -1;
+	bool inside = u >= 0.0f && u < columns && v >= 0.0f && v < rows;
+	if (!inside && (!clipAxis(u, directionX, (float)columns, 0, enter, exit, enterAxis) ||
+		!clipAxis(v, directionZ, (float)rows, 1, enter, exit, enterAxis)))
+		return;
+
+	float pu = u + directionX * enter;
+	float pv = v + directionZ * enter;
+	int column = std::min(std::max((int)std::floor(pu), 0), columns - 1);
+	int row = std::min(std::max((int)std::floor(pv), 0), rows - 1);
+	if (enterAxis == 0)
+	{
+		column = directionX > 0.0f ? 0 : columns - 1;
+		ray.normalX = -ray.stepX;
+	}
+	else if (enterAxis == 1)
+	{
+		row = directionZ > 0.0f ? 0 : rows - 1;
+		ray.normalZ = -ray.stepZ;
+	}
+
+	if (directionX > 0.0f)
+		ray.tMaxX = enter + (column + 1 - pu) * ray.tDeltaX;
+	else if (directionX < 0.0f)
+		ray.tMaxX = enter + (pu - column) * ray.tDeltaX;
+	if (directionZ > 0.0f)
+		ray.tMaxZ = enter + (row + 1 - pv) * ray.tDeltaZ;
+	else if (directionZ < 0.0f)
+		ray.tMaxZ = enter + (pv - row) * ray.tDeltaZ;
+
+	ray.t = enter;
+	ray.column = (float)column;
+	ray.row = (float)row;
+	ray.running = 1.0f;
+}
+
+bool GridRaycaster::walk(RayState& ray) const
+{
+	if (ray.running == 0.0f)
+		return false;
+
+	int columns = tiles->Columns();
+	int rows = tiles->Rows();
+	const unsigned char* cells = tiles->Cells();
+	int column = (int)ray.column;
+	int row = (int)ray.row;
+	int stepX = (int)ray.stepX;
+	int stepZ = (int)ray.stepZ;
+	float t = ray.t;
+	float tMaxX = ray.tMaxX;
+	float tMaxZ = ray.tMaxZ;
+	bool steppedX = ray.normalX != 0.0f;
+	bool hit = false;
+
+	while (column >= 0 && column < columns && row >= 0 && row < rows)
+	{
+		if (cells[row * columns + column])
+		{
+			hit = true;
+			break;
+		}
+
+		steppedX = tMaxX < tMaxZ;
+		if (steppedX)
+		{
+			if (tMaxX > ray.limit)
+				break;
+			t = tMaxX;
+			tMaxX += ray.tDeltaX;
+			column += stepX;
+		}
+		else
+		{
+			if (tMaxZ > ray.limit)
+				break;
+			t = tMaxZ;
+			tMaxZ += ray.tDeltaZ;
+			row += stepZ;
+		}
+	}
+
+	// the normal is the face of the last boundary crossed, none if still in
+	// the start cell
+	if (hit && t > ray.t)
+	{
+		ray.normalX = steppedX ? -ray.stepX : 0.0f;
+		ray.normalZ = steppedX ? 0.0f : -ray.stepZ;
+	}
+	ray.t = t;
+	ray.column = (float)column;
+	ray.row = (float)row;
+	return hit;
+}
+
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+
+// a where the mask is set, b elsewhere
+static inline __m128 selectLanes(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+void GridRaycaster::castPacket(const RayBatch& rays, RayHits& hits, unsigned int first) const
+{
+	int columns = tiles->Columns();
+	int rows = tiles->Rows();
+	const unsigned char* cells = tiles->Cells();
+	glm::vec3 origin = tiles->Origin();
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 farAway = _mm_set1_ps(FAR);
+	__m128 columnCount = _mm_set1_ps((float)columns);
+	__m128 rowCount = _mm_set1_ps((float)rows);
+
+	// setup on four rays, the same steps and divisions so the lanes match walk
+	__m128 u = _mm_add_ps(_mm_sub_ps(_mm_loadu_ps(&rays.originX[first]), _mm_set1_ps(origin.x)), _mm_set1_ps(0.5f));
+	__m128 v = _mm_add_ps(_mm_sub_ps(_mm_loadu_ps(&rays.originZ[first]), _mm_set1_ps(origin.z)), _mm_set1_ps(0.5f));
+	__m128 directionX = _mm_loadu_ps(&rays.directionX[first]);
+	__m128 directionZ = _mm_loadu_ps(&rays.directionZ[first]);
+	__m128 maxDistance = _mm_loadu_ps(&rays.maxDistance[first]);
+
+	__m128 positiveX = _mm_cmpgt_ps(directionX, zero);
+	__m128 positiveZ = _mm_cmpgt_ps(directionZ, zero);
+	__m128 flatX = _mm_cmpeq_ps(directionX, zero);
+	__m128 flatZ = _mm_cmpeq_ps(directionZ, zero);
+	__m128 stepX = selectLanes(positiveX, one, _mm_set1_ps(-1.0f));
+	__m128 stepZ = selectLanes(positiveZ, one, _mm_set1_ps(-1.0f));
+	__m128 divisorX = selectLanes(flatX, one, directionX);
+	__m128 divisorZ = selectLanes(flatZ, one, directionZ);
+	__m128 tDeltaX = selectLanes(flatX, farAway, _mm_div_ps(one, _mm_andnot_ps(_mm_set1_ps(-0.0f), divisorX)));
+	__m128 tDeltaZ = selectLanes(flatZ, farAway, _mm_div_ps(one, _mm_andnot_ps(_mm_set1_ps(-0.0f), divisorZ)));
+
+	// rays starting outside are clipped to the map, rays that miss it never start
+	__m128 insideX = _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmplt_ps(u, columnCount));
+	__m128 insideZ = _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmplt_ps(v, rowCount));
+	__m128 inside = _mm_and_ps(insideX, insideZ);
+	__m128 t0 = _mm_div_ps(_mm_sub_ps(zero, u), divisorX);
+	__m128 t1 = _mm_div_ps(_mm_sub_ps(columnCount, u), divisorX);
+	__m128 enterX = selectLanes(flatX, _mm_set1_ps(-FAR), _mm_min_ps(t0, t1));
+	__m128 exitX = selectLanes(flatX, farAway, _mm_max_ps(t0, t1));
+	t0 = _mm_div_ps(_mm_sub_ps(zero, v), divisorZ);
+	t1 = _mm_div_ps(_mm_sub_ps(rowCount, v), divisorZ);
+	__m128 enterZ = selectLanes(flatZ, _mm_set1_ps(-FAR), _mm_min_ps(t0, t1));
+	__m128 exitZ = selectLanes(flatZ, farAway, _mm_max_ps(t0, t1));
+
+	__m128 entersX = _mm_andnot_ps(inside, _mm_cmpgt_ps(enterX, zero));
+	__m128 enter = _mm_and_ps(entersX, enterX);
+	__m128 entersZ = _mm_andnot_ps(inside, _mm_cmpgt_ps(enterZ, enter));
+	entersX = _mm_andnot_ps(entersZ, entersX);
+	enter = selectLanes(entersZ, enterZ, enter);
+	__m128 exit = _mm_min_ps(maxDistance, _mm_min_ps(exitX, exitZ));
+	__m128 parallelOutside = _mm_or_ps(_mm_andnot_ps(insideX, flatX), _mm_andnot_ps(insideZ, flatZ));
+	__m128 running = _mm_or_ps(inside, _mm_andnot_ps(parallelOutside, _mm_cmple_ps(enter, exit)));
+
+	// floor and clamp in floats, SSE2 has neither for ints
+	__m128 pu = _mm_add_ps(u, _mm_mul_ps(directionX, enter));
+	__m128 pv = _mm_add_ps(v, _mm_mul_ps(directionZ, enter));
+	__m128 floorU = _mm_cvtepi32_ps(_mm_cvttps_epi32(pu));
+	floorU = _mm_sub_ps(floorU, _mm_and_ps(_mm_cmpgt_ps(floorU, pu), one));
+	__m128 floorV = _mm_cvtepi32_ps(_mm_cvttps_epi32(pv));
+	floorV = _mm_sub_ps(floorV, _mm_and_ps(_mm_cmpgt_ps(floorV, pv), one));
+	__m128 columnF = _mm_min_ps(_mm_max_ps(floorU, zero), _mm_sub_ps(columnCount, one));
+	__m128 rowF = _mm_min_ps(_mm_max_ps(floorV, zero), _mm_sub_ps(rowCount, one));
+	columnF = selectLanes(entersX, selectLanes(positiveX, zero, _mm_sub_ps(columnCount, one)), columnF);
+	rowF = selectLanes(entersZ, selectLanes(positiveZ, zero, _mm_sub_ps(rowCount, one)), rowF);
+	__m128 enterNormalX = _mm_and_ps(entersX, _mm_sub_ps(zero, stepX));
+	__m128 enterNormalZ = _mm_and_ps(entersZ, _mm_sub_ps(zero, stepZ));
+
+	__m128 tMaxX = _mm_add_ps(enter, _mm_mul_ps(selectLanes(positiveX, _mm_sub_ps(_mm_add_ps(columnF, one), pu), _mm_sub_ps(pu, columnF)), tDeltaX));
+	__m128 tMaxZ = _mm_add_ps(enter, _mm_mul_ps(selectLanes(positiveZ, _mm_sub_ps(_mm_add_ps(rowF, one), pv), _mm_sub_ps(pv, rowF)), tDeltaZ));
+	tMaxX = selectLanes(flatX, farAway, tMaxX);
+	tMaxZ = selectLanes(flatZ, farAway, tMaxZ);
+	__m128 start = enter;
+	__m128 t = enter;
+	__m128 limit = maxDistance;
+
+	// walk, the wall lookup is the only per lane work
+	__m128i column = _mm_cvttps_epi32(columnF);
+	__m128i row = _mm_cvttps_epi32(rowF);
+	__m128i intStepX = _mm_cvttps_epi32(stepX);
+	__m128i intStepZ = _mm_cvttps_epi32(stepZ);
+	__m128i intColumns = _mm_set1_epi32(columns);
+	__m128i stepIndexZ = _mm_cvttps_epi32(_mm_mul_ps(stepZ, columnCount));
+	__m128i index = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(rowF, columnCount), columnF));
+	__m128i none = _mm_set1_epi32(-1);
+	__m128i intRows = _mm_set1_epi32(rows);
+	__m128 hit = zero;
+	__m128 steppedX = zero;
+	while (true)
+	{
+		// lanes still walking inside the map look up their cell, the rest read cell 0
+		__m128i within = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(column, none), _mm_cmplt_epi32(column, intColumns)),
+			_mm_and_si128(_mm_cmpgt_epi32(row, none), _mm_cmplt_epi32(row, intRows)));
+		__m128 live = _mm_and_ps(running, _mm_castsi128_ps(within));
+		if (_mm_movemask_ps(live) == 0)
+			break;
+
+		__m128i look = _mm_and_si128(index, _mm_castps_si128(live));
+		__m128i wall = _mm_setr_epi32(cells[_mm_cvtsi128_si32(look)], cells[_mm_cvtsi128_si32(_mm_shuffle_epi32(look, 1))],
+			cells[_mm_cvtsi128_si32(_mm_shuffle_epi32(look, 2))], cells[_mm_cvtsi128_si32(_mm_shuffle_epi32(look, 3))]);
+		__m128 isWall = _mm_and_ps(live, _mm_castsi128_ps(_mm_cmpgt_epi32(wall, _mm_setzero_si128())));
+		hit = _mm_or_ps(hit, isWall);
+		running = _mm_andnot_ps(isWall, live);
+
+		// step the nearer boundary, lanes that would pass their limit stop
+		__m128 stepsX = _mm_cmplt_ps(tMaxX, tMaxZ);
+		__m128 nextT = selectLanes(stepsX, tMaxX, tMaxZ);
+		running = _mm_andnot_ps(_mm_cmplt_ps(limit, nextT), running);
+		__m128 movesX = _mm_and_ps(running, stepsX);
+		__m128 movesZ = _mm_andnot_ps(stepsX, running);
+		__m128i intMovesX = _mm_castps_si128(movesX);
+		__m128i intMovesZ = _mm_castps_si128(movesZ);
+
+		t = selectLanes(running, nextT, t);
+		steppedX = selectLanes(running, stepsX, steppedX);
+		tMaxX = _mm_add_ps(tMaxX, _mm_and_ps(movesX, tDeltaX));
+		tMaxZ = _mm_add_ps(tMaxZ, _mm_and_ps(movesZ, tDeltaZ));
+		column = _mm_add_epi32(column, _mm_and_si128(intMovesX, intStepX));
+		row = _mm_add_epi32(row, _mm_and_si128(intMovesZ, intStepZ));
+		index = _mm_add_epi32(index, _mm_or_si128(_mm_and_si128(intMovesX, intStepX), _mm_and_si128(intMovesZ, stepIndexZ)));
+	}
+
+	// same normal rule as walk, the entry face if the ray never left its start cell
+	__m128 moved = _mm_cmpgt_ps(t, start);
+	__m128 normalX = selectLanes(moved, _mm_and_ps(steppedX, _mm_sub_ps(zero, stepX)), enterNormalX);
+	__m128 normalZ = selectLanes(moved, _mm_andnot_ps(steppedX, _mm_sub_ps(zero, stepZ)), enterNormalZ);
+	_mm_storeu_si128((__m128i*)&hits.cell[first], _mm_or_si128(_mm_and_si128(_mm_castps_si128(hit), index), _mm_andnot_si128(_mm_castps_si128(hit), none)));
+	_mm_storeu_ps(&hits.distance[first], selectLanes(hit, t, maxDistance));
+	_mm_storeu_ps(&hits.normalX[first], _mm_and_ps(hit, normalX));
+	_mm_storeu_ps(&hits.normalZ[first], _mm_and_ps(hit, normalZ));
+}
+
+#endif
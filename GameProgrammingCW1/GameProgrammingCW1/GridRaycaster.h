@@ -0,0 +1,101 @@
+#ifndef GRID_RAYCASTER_H
+#define GRID_RAYCASTER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "TileMap.h"
+#include "ThreadPool.h"
+
+// Rays on the xz plane, structure of arrays. Directions are normalised by Add
+// so distances along a ray are in world units.
+struct RayBatch
+{
+	std::vector<float> originX, originZ;
+	std::vector<float> directionX, directionZ;
+	std::vector<float> maxDistance;
+
+	void Add(glm::vec3 origin, glm::vec3 direction, float maxDistance);
+	void Clear();
+	unsigned int Size() const { return originX.size(); }
+};
+
+// First wall cell each ray hits. Misses have cell -1, distance maxDistance
+// and a zero normal. A ray starting inside a wall hits it at distance 0 with a
+// zero normal.
+struct RayHits
+{
+	std::vector<int> cell;				// row * Columns() + column
+	std::vector<float> distance;
+	std::vector<float> normalX, normalZ;	// face of the cell the ray entered
+
+	bool Hit(unsigned int i) const { return cell[i] >= 0; }
+	unsigned int Size() const { return cell.size(); }
+};
+
+// Amanatides-Woo traversal of a TileMap: each ray walks the cells it crosses
+// in order, one cell boundary per iteration, until it finds a wall, leaves the
+// map or passes its max distance. Rays outside the map are clipped to it first.
+// Batches split into chunks that can run on a ThreadPool. With useSimd and
+// SSE2 the rays of a chunk go four at a time: setup is done on all four lanes
+// and they walk in lockstep, stepping x or z per lane with masks, until the
+// last one stops. Only the wall lookup is per lane. Results match the one at
+// a time walk exactly.
+class GridRaycaster
+{
+public:
+	GridRaycaster();
+	~GridRaycaster();
+
+	// walls to cast against, not owned
+	void SetTiles(const TileMap* tiles) { this->tiles = tiles; }
+
+	// null casts on the calling thread only
+	void SetThreadPool(ThreadPool* pool) { threads = pool; }
+
+	// one ray, returns whether it hit a wall
+	bool Cast(glm::vec3 origin, glm::vec3 direction, float maxDistance, int& cell, float& distance, glm::vec3& normal) const;
+
+	// every ray in the batch, hits is resized to match
+	void Cast(const RayBatch& rays, RayHits& hits) const;
+
+	// true when no wall lies between the two points
+	bool LineOfSight(glm::vec3 from, glm::vec3 to) const;
+
+	// cast batches four rays at a time, ignored without SSE2
+	bool useSimd = true;
+
+	// rays per job, a multiple of four
+	static const unsigned int CHUNK_SIZE = 1024;
+
+private:
+	// traversal state of one ray, in cell units where cell (row, column)
+	// covers [column, column + 1) x [row, row + 1)
+	struct RayState
+	{
+		float t;					// distance travelled
+		float limit;
+		float tMaxX, tMaxZ;			// distance to the next x / z boundary
+		float tDeltaX, tDeltaZ;		// distance between x / z boundaries
+		float stepX, stepZ;
+		float column, row;
+		float normalX, normalZ;
+		float running;				// 1.0 while walking
+	};
+
+	const TileMap* tiles = nullptr;
+	ThreadPool* threads = nullptr;
+
+	void setup(float originX, float originZ, float directionX, float directionZ, float maxDistance, RayState& ray) const;
+	// one ray on its own, returns whether it stopped on a wall
+	bool walk(RayState& ray) const;
+
+	// rays first to first + 3 in SSE lanes, their state kept in registers
+	// until all four have stopped
+	void castPacket(const RayBatch& rays, RayHits& hits, unsigned int first) const;
+
+	void castRange(const RayBatch& rays, RayHits& hits, unsigned int begin, unsigned int end) const;
+};
+
+#endif // !GRID_RAYCASTER_H
@@ -0,0 +1,172 @@
+#include "KdTree.h"
+#include <algorithm>
+
+// defined here as well since std::min takes them by reference
+const unsigned int KdTree::LEAF_SIZE;
+const unsigned int KdTree::MAX_K;
+
+// k best candidates so far, sorted by distance
+struct KdTree::Candidates
+{
+	unsigned int k;
+	unsigned int count;
+	float worst;	// squared distance a point has to beat
+	unsigned int slot[MAX_K];
+	float distance2[MAX_K];
+
+	void Insert(unsigned int s, float d2)
+	{
+		unsigned int i = count < k ? count++ : k - 1;
+		while (i > 0 && distance2[i - 1] > d2)
+		{
+			slot[i] = slot[i - 1];
+			distance2[i] = distance2[i - 1];
+			i--;
+		}
+		slot[i] = s;
+		distance2[i] = d2;
+		if (count == k)
+		{
+			worst = distance2[k - 1];
+		}
+	}
+};
+
+KdTree::KdTree()
+{
+}
+
+KdTree::~KdTree()
+{
+}
+
+void KdTree::Build(const float* x, const float* y, const float* z, unsigned int count)
+{
+	// new point set, start from the identity order
+	if (count != this->count || order.size() != count)
+	{
+		order.resize(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			order[i] = i;
+		}
+	}
+	this->count = count;
+
+	pointX.assign(x, x + count);
+	pointY.assign(y, y + count);
+	pointZ.assign(z, z + count);
+	splitAxis.resize(count);
+
+	build(0, count);
+
+	treeX.resize(count);
+	treeY.resize(count);
+	treeZ.resize(count);
+	for (unsigned int s = 0; s < count; s++)
+	{
+		treeX[s] = pointX[order[s]];
+		treeY[s] = pointY[order[s]];
+		treeZ[s] = pointZ[order[s]];
+	}
+}
+
+void KdTree::build(unsigned int begin, unsigned int end)
+{
+	if (end - begin <= LEAF_SIZE)
+		return;
+
+	// split on the axis with the largest extent
+	glm::vec3 low(pointX[order[begin]], pointY[order[begin]], pointZ[order[begin]]);
+	glm::vec3 high = low;
+	for (unsigned int s = begin + 1; s < end; s++)
+	{
+		glm::vec3 p(pointX[order[s]], pointY[order[s]], pointZ[order[s]]);
+		low = glm::min(low, p);
+		high = glm::max(high, p);
+	}
+	glm::vec3 extent = high - low;
+	unsigned char axis = 0;
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+
+	const float* coords = axis == 0 ? &pointX[0] : axis == 1 ? &pointY[0] : &pointZ[0];
+	unsigned int middle = (begin + end) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+		[coords](unsigned int a, unsigned int b) { return coords[a] < coords[b]; });
+	splitAxis[middle] = axis;
+
+	build(begin, middle);
+	build(middle + 1, end);
+}
+
+unsigned int KdTree::Query(glm::vec3 position, unsigned int k, float maxDistance, unsigned int* outIndices) const
+{
+	Candidates candidates;
+	candidates.k = std::min(k, MAX_K);
+	candidates.count = 0;
+	candidates.worst = maxDistance * maxDistance;
+
+	if (count > 0 && candidates.k > 0)
+	{
+		search(0, count, position, candidates);
+	}
+
+	for (unsigned int i = 0; i < candidates.count; i++)
+	{
+		outIndices[i] = order[candidates.slot[i]];
+	}
+	return candidates.count;
+}
+
+void KdTree::QueryBatch(unsigned int begin, unsigned int end, unsigned int k, float maxDistance, unsigned int* outIndices, unsigned int* outCounts) const
+{
+	for (unsigned int i = begin; i < end; i++)
+	{
+		glm::vec3 position(pointX[i], pointY[i], pointZ[i]);
+		outCounts[i] = Query(position, k, maxDistance, &outIndices[i * k]);
+	}
+}
+
+void KdTree::search(unsigned int begin, unsigned int end, glm::vec3 position, Candidates& candidates) const
+{
+	if (end - begin <= LEAF_SIZE)
+	{
+		for (unsigned int s = begin; s < end; s++)
+		{
+			glm::vec3 offset = position - glm::vec3(treeX[s], treeY[s], treeZ[s]);
+			float d2 = glm::dot(offset, offset);
+			if (d2 < candidates.worst)
+			{
+				candidates.Insert(s, d2);
+			}
+		}
+		return;
+	}
+
+	unsigned int middle = (begin + end) / 2;
+	glm::vec3 split(treeX[middle], treeY[middle], treeZ[middle]);
+
+	glm::vec3 offset = position - split;
+	float d2 = glm::dot(offset, offset);
+	if (d2 < candidates.worst)
+	{
+		candidates.Insert(middle, d2);
+	}
+
+	// near side first, the far side only if the splitting plane is closer
+	// than the current worst candidate
+	float planeDistance = offset[splitAxis[middle]];
+	if (planeDistance < 0)
+	{
+		search(begin, middle, position, candidates);
+		if (planeDistance * planeDistance < candidates.worst)
+			search(middle + 1, end, position, candidates);
+	}
+	else
+	{
+		search(middle + 1, end, position, candidates);
+		if (planeDistance * planeDistance < candidates.worst)
+			search(begin, middle, position, candidates);
+	}
+}
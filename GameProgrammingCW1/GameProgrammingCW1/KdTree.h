@@ -0,0 +1,48 @@
+#ifndef KD_TREE_H
+#define KD_TREE_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Balanced k-d tree over a set of points for k nearest neighbour queries.
+// The tree is implicit: points are reordered so every node is a range with its
+// splitting point in the middle. Build keeps the order of the previous frame,
+// boids barely move between frames so the partitioning has little to do.
+class KdTree
+{
+public:
+	KdTree();
+	~KdTree();
+
+	void Build(const float* x, const float* y, const float* z, unsigned int count);
+
+	// up to k nearest points closer than maxDistance, nearest first.
+	// Returns how many indices were written to outIndices (room for k).
+	unsigned int Query(glm::vec3 position, unsigned int k, float maxDistance, unsigned int* outIndices) const;
+
+	// Query for points [begin, end) of the built set. Results of point i are
+	// written at outIndices[i * k], their count at outCounts[i]. The point itself
+	// is included (distance 0).
+	void QueryBatch(unsigned int begin, unsigned int end, unsigned int k, float maxDistance, unsigned int* outIndices, unsigned int* outCounts) const;
+
+	unsigned int Size() const { return count; }
+
+	static const unsigned int LEAF_SIZE = 8;
+	static const unsigned int MAX_K = 32;
+
+private:
+	unsigned int count = 0;
+
+	std::vector<unsigned int> order;		// original index of every tree slot
+	std::vector<float> treeX, treeY, treeZ;	// positions in tree order
+	std::vector<unsigned char> splitAxis;	// axis of the node whose middle is this slot
+	std::vector<float> pointX, pointY, pointZ;	// positions in original order
+
+	void build(unsigned int begin, unsigned int end);
+
+	struct Candidates;
+	void search(unsigned int begin, unsigned int end, glm::vec3 position, Candidates& candidates) const;
+};
+
+#endif // !KD_TREE_H
@@ -0,0 +1,144 @@
+#include "Log.h"
+#include <cstdio>
+#include <cstdarg>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace
+{
+	const unsigned int RING_SIZE = 1024;	// power of two
+	const unsigned int MESSAGE_LENGTH = 120;
+
+	const char* levelNames[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+	const char* categoryNames[] = { "general", "physics", "collision", "flock", "astar", "particles" };
+
+	struct Message
+	{
+		int level;
+		LogCategory category;
+		char text[MESSAGE_LENGTH];
+	};
+
+	std::atomic<unsigned int> enabledCategories(~0u);
+
+	// ring buffer, head and tail only grow and wrap through the mask
+	Message ring[RING_SIZE];
+	unsigned int head = 0;
+	unsigned int tail = 0;
+	std::atomic<unsigned int> dropped(0);
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread printer;
+	bool async = false;
+	bool quit = false;
+
+	void print(const Message& message)
+	{
+		std::printf("[%s %s] %s\n", levelNames[message.level], categoryNames[(int)message.category], message.text);
+	}
+
+	void printLoop()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [] { return quit || head != tail; });
+
+			// print outside the lock so writers are never held up by the console
+			while (head != tail)
+			{
+				Message message = ring[tail & (RING_SIZE - 1)];
+				tail++;
+				lock.unlock();
+				print(message);
+				lock.lock();
+			}
+
+			if (quit)
+				break;
+		}
+	}
+}
+
+void Log::SetCategoryEnabled(LogCategory category, bool enabled)
+{
+	unsigned int bit = 1u << (int)category;
+	if (enabled)
+		enabledCategories |= bit;
+	else
+		enabledCategories &= ~bit;
+}
+
+bool Log::IsCategoryEnabled(LogCategory category)
+{
+	return (enabledCategories.load(std::memory_order_relaxed) & (1u << (int)category)) != 0;
+}
+
+void Log::Write(int level, LogCategory category, const char* format, ...)
+{
+	Message message;
+	message.level = level;
+	message.category = category;
+
+	va_list args;
+	va_start(args, format);
+	std::vsnprintf(message.text, MESSAGE_LENGTH, format, args);
+	va_end(args);
+
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (async)
+		{
+			if (head - tail == RING_SIZE)
+			{
+				dropped++;
+				return;
+			}
+			ring[head & (RING_SIZE - 1)] = message;
+			head++;
+			queued = true;
+		}
+	}
+
+	if (queued)
+	{
+		wake.notify_one();
+		return;
+	}
+	print(message);
+}
+
+void Log::StartAsync()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (async)
+		return;
+
+	async = true;
+	quit = false;
+	printer = std::thread(printLoop);
+}
+
+void Log::StopAsync()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!async)
+			return;
+		quit = true;
+	}
+	wake.notify_one();
+	printer.join();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	async = false;
+}
+
+unsigned int Log::Dropped()
+{
+	return dropped;
+}
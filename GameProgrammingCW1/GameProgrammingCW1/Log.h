@@ -0,0 +1,79 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Levelled, categorised logging.
+// Messages below LOG_MIN_LEVEL are removed by the preprocessor, arguments
+// included, so trace and debug calls cost nothing in release builds. Define
+// LOG_MIN_LEVEL before including this header (or in the project settings) to
+// keep more or less.
+// Categories can be switched on and off at run time. Messages go straight to
+// stdout until StartAsync, then they are copied into a ring buffer and printed
+// by a background thread; when the buffer is full new messages are dropped
+// rather than stalling the caller.
+
+#define LOG_LEVEL_TRACE	0
+#define LOG_LEVEL_DEBUG	1
+#define LOG_LEVEL_INFO	2
+#define LOG_LEVEL_WARN	3
+#define LOG_LEVEL_ERROR	4
+#define LOG_LEVEL_OFF	5
+
+#ifndef LOG_MIN_LEVEL
+	#if defined(_DEBUG)
+		#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+	#else
+		#define LOG_MIN_LEVEL LOG_LEVEL_WARN
+	#endif
+#endif
+
+enum class LogCategory { General, Physics, Collision, Flock, Astar, Particles, Count };
+
+namespace Log
+{
+	void SetCategoryEnabled(LogCategory category, bool enabled);
+	bool IsCategoryEnabled(LogCategory category);
+
+	// printf style, use the LOG_ macros instead so calls can be compiled out
+	void Write(int level, LogCategory category, const char* format, ...);
+
+	void StartAsync();
+	// prints whatever is still buffered and stops the background thread
+	void StopAsync();
+	// messages dropped because the ring buffer was full
+	unsigned int Dropped();
+}
+
+#define LOG_WRITE(level, category, ...) \
+	do { if (Log::IsCategoryEnabled(category)) Log::Write(level, category, __VA_ARGS__); } while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_TRACE
+	#define LOG_TRACE(category, ...) LOG_WRITE(LOG_LEVEL_TRACE, category, __VA_ARGS__)
+#else
+	#define LOG_TRACE(category, ...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+	#define LOG_DEBUG(category, ...) LOG_WRITE(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#else
+	#define LOG_DEBUG(category, ...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+	#define LOG_INFO(category, ...) LOG_WRITE(LOG_LEVEL_INFO, category, __VA_ARGS__)
+#else
+	#define LOG_INFO(category, ...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+	#define LOG_WARN(category, ...) LOG_WRITE(LOG_LEVEL_WARN, category, __VA_ARGS__)
+#else
+	#define LOG_WARN(category, ...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+	#define LOG_ERROR(category, ...) LOG_WRITE(LOG_LEVEL_ERROR, category, __VA_ARGS__)
+#else
+	#define LOG_ERROR(category, ...) ((void)0)
+#endif
+
+#endif // !LOG_H
@@ -0,0 +1,197 @@
+#include "ParticleStore.h"
+#include "SimdFloat.h"
+#include <algorithm>
+#include <cmath>
+
+ParticleStore::ParticleStore()
+{
+}
+
+ParticleStore::~ParticleStore()
+{
+}
+
+void ParticleStore::Reserve(unsigned int capacity)
+{
+	this->capacity = capacity;
+	liveCount = 0;
+	slotVersion++;
+	instance.assign(capacity * 4, 0.0f);
+	velocityX.assign(capacity, 0.0f);
+	velocityY.assign(capacity, 0.0f);
+	velocityZ.assign(capacity, 0.0f);
+	life.assign(capacity, 0.0f);
+	color.assign(capacity, 0xffffffffu);
+}
+
+unsigned int ParticleStore::Spawn(unsigned int& count)
+{
+	unsigned int first = liveCount;
+	count = std::min(count, capacity - liveCount);
+	liveCount += count;
+	if (count > 0)
+	{
+		slotVersion++;
+	}
+	return first;
+}
+
+void ParticleStore::Step(float deltaTime)
+{
+	unsigned int chunkCount = beginStep();
+	auto job = [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int chunk = begin; chunk < end; chunk++)
+		{
+			integrate(chunk, deltaTime);
+		}
+	};
+
+	if (threads)
+	{
+		threads->ParallelFor(chunkCount, 1, job);
+	}
+	else
+	{
+		job(0, chunkCount);
+	}
+	compact();
+}
+
+void ParticleStore::StepAll(const std::vector<ParticleStore*>& stores, float deltaTime, ThreadPool* pool)
+{
+	// chunk j of the combined loop is chunk j - first[s] of store s
+	std::vector<unsigned int> first(stores.size() + 1, 0);
+	for (unsigned int s = 0; s < stores.size(); s++)
+	{
+		first[s + 1] = first[s] + stores[s]->beginStep();
+	}
+
+	auto job = [&](unsigned int begin, unsigned int end)
+	{
+		unsigned int s = std::upper_bound(first.begin(), first.end(), begin) - first.begin() - 1;
+		for (unsigned int chunk = begin; chunk < end; chunk++)
+		{
+			while (chunk >= first[s + 1])
+				s++;
+			stores[s]->integrate(chunk - first[s], deltaTime);
+		}
+	};
+
+	if (pool)
+	{
+		pool->ParallelFor(first.back(), 1, job);
+	}
+	else
+	{
+		job(0, first.back());
+	}
+
+	for (ParticleStore* store : stores)
+	{
+		store->compact();
+	}
+}
+
+unsigned int ParticleStore::beginStep()
+{
+	unsigned int chunkCount = (liveCount + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	if (chunkDead.size() < chunkCount)
+	{
+		chunkDead.resize(chunkCount);
+		chunkFastest.resize(chunkCount);
+	}
+	for (unsigned int chunk = 0; chunk < chunkCount; chunk++)
+	{
+		chunkDead[chunk].clear();
+	}
+	return chunkCount;
+}
+
+void ParticleStore::integrate(unsigned int chunk, float deltaTime)
+{
+	unsigned int begin = chunk * CHUNK_SIZE;
+	unsigned int end = std::min(begin + CHUNK_SIZE, liveCount);
+	float* positionX = PositionX();
+	float* positionY = PositionY();
+	float* positionZ = PositionZ();
+	float damping = std::max(1.0f - drag * deltaTime, 0.0f);
+	std::vector<unsigned int>& dead = chunkDead[chunk];
+	float fastest[8] = {};	// per lane, wide enough for every SimdFloat
+
+	RunKernel(begin, end, [&](unsigned int i, auto lane)
+	{
+		typedef decltype(lane) F;
+		F dt(deltaTime);
+		F damp(damping);
+
+		F vx = F::Load(&velocityX[i]) * damp;
+		F vy = (F::Load(&velocityY[i]) + F(gravity) * dt) * damp;
+		F vz = F::Load(&velocityZ[i]) * damp;
+		vx.Store(&velocityX[i]);
+		vy.Store(&velocityY[i]);
+		vz.Store(&velocityZ[i]);
+		Max(F::Load(fastest), vx * vx + vy * vy + vz * vz).Store(fastest);
+
+		(F::Load(&positionX[i]) + vx * dt).Store(&positionX[i]);
+		(F::Load(&positionY[i]) + vy * dt).Store(&positionY[i]);
+		(F::Load(&positionZ[i]) + vz * dt).Store(&positionZ[i]);
+
+		F left = F::Load(&life[i]) - dt;
+		left.Store(&life[i]);
+		if (Any(left < F(1e-6f)))
+		{
+			for (unsigned int k = i; k < i + F::Width; k++)
+			{
+				if (life[k] <= 0.0f)
+					dead.push_back(k);
+			}
+		}
+	});
+	chunkFastest[chunk] = *std::max_element(fastest, fastest + 8);
+}
+
+void ParticleStore::compact()
+{
+	float* positionX = PositionX();
+	float* positionY = PositionY();
+	float* positionZ = PositionZ();
+	float* scale = Scale();
+
+	// highest first, so the last particle is always live when it is moved
+	unsigned int chunkCount = (liveCount + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	float fastest = 0.0f;
+	for (unsigned int chunk = 0; chunk < chunkCount; chunk++)
+	{
+		fastest = std::max(fastest, chunkFastest[chunk]);
+	}
+	maxSpeed = std::sqrt(fastest);
+
+	unsigned int before = liveCount;
+
+	for (unsigned int chunk = chunkCount; chunk-- > 0;)
+	{
+		const std::vector<unsigned int>& dead = chunkDead[chunk];
+		for (unsigned int d = dead.size(); d-- > 0;)
+		{
+			unsigned int i = dead[d];
+			unsigned int last = --liveCount;
+			if (i == last)
+				continue;
+
+			positionX[i] = positionX[last];
+			positionY[i] = positionY[last];
+			positionZ[i] = positionZ[last];
+			scale[i] = scale[last];
+			velocityX[i] = velocityX[last];
+			velocityY[i] = velocityY[last];
+			velocityZ[i] = velocityZ[last];
+			life[i] = life[last];
+			color[i] = color[last];
+		}
+	}
+	if (liveCount != before)
+	{
+		slotVersion++;
+	}
+}
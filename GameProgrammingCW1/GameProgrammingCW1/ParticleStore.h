@@ -0,0 +1,92 @@
+#ifndef PARTICLE_STORE_H
+#define PARTICLE_STORE_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "ThreadPool.h"
+
+// Particle state as structure of arrays with a fixed capacity. Live particles
+// are packed at the front, a particle that dies is replaced by the last live
+// one and the slots past LiveCount() are the free list Spawn takes from.
+// The kernel lists the particles that died so compaction only visits them.
+// Positions and scales are kept in the layout the instance buffer is uploaded
+// in, four blocks of Capacity() floats: x | y | z | scale. Step integrates
+// straight into it on SimdFloat lanes.
+// Steps run in fixed size chunks of the live range, on a ThreadPool when one
+// is set. Each chunk writes its own slice of the blocks and keeps its own list
+// of the dead, so the result does not depend on the number of threads.
+// StepAll spreads the chunks of several stores over the pool in one go.
+class ParticleStore
+{
+public:
+	ParticleStore();
+	~ParticleStore();
+
+	void Reserve(unsigned int capacity);
+	void Clear() { liveCount = 0; slotVersion++; }
+
+	// makes up to count free particles live, count is set to how many were,
+	// returns the index of the first one for the caller to fill in
+	unsigned int Spawn(unsigned int& count);
+
+	// null steps on the calling thread only
+	void SetThreadPool(ThreadPool* pool) { threads = pool; }
+
+	// velocity, gravity on y, drag, position and age for every live particle,
+	// then the dead ones are compacted away
+	void Step(float deltaTime);
+
+	// Step for every store, chunks of all of them share one parallel loop
+	static void StepAll(const std::vector<ParticleStore*>& stores, float deltaTime, ThreadPool* pool);
+
+	float gravity = 0.0f;
+	float drag = 0.0f;			// fraction of velocity lost per second
+
+	// particles per job, a multiple of every SimdFloat width
+	static const unsigned int CHUNK_SIZE = 16384;
+
+	unsigned int Capacity() const { return capacity; }
+	unsigned int LiveCount() const { return liveCount; }
+	// fastest particle of the last Step, units per second
+	float MaxSpeed() const { return maxSpeed; }
+	// changes whenever a slot starts holding a different particle (spawns,
+	// deaths, Clear), indices saved before a change no longer mean the same
+	unsigned int SlotVersion() const { return slotVersion; }
+
+	float* PositionX() { return instance.data(); }
+	float* PositionY() { return instance.data() + capacity; }
+	float* PositionZ() { return instance.data() + 2 * capacity; }
+	float* Scale() { return instance.data() + 3 * capacity; }
+	float* VelocityX() { return velocityX.data(); }
+	float* VelocityY() { return velocityY.data(); }
+	float* VelocityZ() { return velocityZ.data(); }
+	float* Life() { return life.data(); }				// seconds left, dead at 0
+	unsigned int* Color() { return color.data(); }		// RGBA8
+
+	// x | y | z | scale blocks, Capacity() floats each
+	const float* InstanceData() const { return instance.data(); }
+	const unsigned int* ColorData() const { return color.data(); }
+
+private:
+	unsigned int capacity = 0;
+	unsigned int liveCount = 0;
+	float maxSpeed = 0.0f;
+	unsigned int slotVersion = 0;
+
+	std::vector<float> instance;
+	std::vector<float> velocityX, velocityY, velocityZ;
+	std::vector<float> life;
+	std::vector<unsigned int> color;
+	std::vector<std::vector<unsigned int>> chunkDead;	// died this step per chunk, ascending
+	std::vector<float> chunkFastest;					// squared speed per chunk
+
+	ThreadPool* threads = nullptr;
+
+	unsigned int beginStep();
+	void integrate(unsigned int chunk, float deltaTime);
+	void compact();
+};
+
+#endif // !PARTICLE_STORE_H
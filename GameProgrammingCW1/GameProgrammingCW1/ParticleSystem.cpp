@@ -1,5 +1,6 @@
 #include "ParticleSystem.h"
-#include <time.h>
+#include "Random.h"
+#include <algorithm>
 #include <iostream>
 #include <glm/gtx/string_cast.hpp>
 
@@ -17,8 +18,6 @@ void ParticleSystem::Init()
 {
 	//compile shader program
 	loadShader();
-	//fill particles array
-	generateParticles();
 
 	//texture
 	int width, height, channels;
@@ -75,30 +74,122 @@ void ParticleSystem::Init()
 
 void ParticleSystem::Update(float delta)
 {
-	unsigned int count = 0;
-	for (unsigned int i = 0; i < maxParticles; i++)
+	spawnDue(delta);
+	store.drag = drag;
+	store.Step(delta);
+	sorter.Moved(store.MaxSpeed() * delta);
+	UpdateBuffers();
+}
+
+void ParticleSystem::UpdateAll(const std::vector<ParticleSystem*>& systems, float delta, ThreadPool* pool)
+{
+	std::vector<ParticleStore*> stores;
+	for (ParticleSystem* system : systems)
 	{
-		setParticlesBuffer(i, count);
-		count++;
+		system->spawnDue(delta);
+		system->store.drag = system->drag;
+		stores.push_back(&system->store);
 	}
-	UpdateBuffers();
+
+	ParticleStore::StepAll(stores, delta, pool);
+
+	// GL calls stay on this thread
+	for (ParticleSystem* system : systems)
+	{
+		system->sorter.Moved(system->store.MaxSpeed() * delta);
+		system->UpdateBuffers();
+	}
+}
+
+void ParticleSystem::spawnDue(float delta)
+{
+	spawnDebt += spawnRate * delta;
+	if (spawnDebt >= 1.0f)
+	{
+		unsigned int due = (unsigned int)spawnDebt;
+		spawnDebt -= due;
+		Emit(due);
+	}
+}
+
+void ParticleSystem::Emit(unsigned int count)
+{
+	unsigned int first = store.Spawn(count);
+	generateParticles(first, count);
 }
 
 void ParticleSystem::UpdateBuffers()
 {
+	// sorted uploads wait for the view in Render
+	if (depthSort)
+	{
+		sortedDirty = true;
+		return;
+	}
+	upload(store.InstanceData(), store.ColorData());
+}
+
+void ParticleSystem::upload(const float* instance, const unsigned int* color)
+{
+	// one block per attribute, only the live front of each is uploaded
+	unsigned int liveCount = store.LiveCount();
 	glBindVertexArray(vao);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo_position);
 	glBufferData(GL_ARRAY_BUFFER, maxParticles * 4 * sizeof(GLfloat), NULL, GL_STREAM_DRAW); //orphaning, allocating faster than sync
-	glBufferSubData(GL_ARRAY_BUFFER, 0, maxParticles * sizeof(GLfloat) * 4, position_data);
+	for (unsigned int block = 0; block < 4; block++)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, block * maxParticles * sizeof(GLfloat), liveCount * sizeof(GLfloat), instance + block * maxParticles);
+	}
 
 	glBindBuffer(GL_ARRAY_BUFFER, vbo_color);
 	glBufferData(GL_ARRAY_BUFFER, maxParticles * 4 * sizeof(GLubyte), NULL, GL_STREAM_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, maxParticles * sizeof(GLubyte) * 4, color_data);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, liveCount * sizeof(GLubyte) * 4, color);
+
+}
+
+void ParticleSystem::sortForView(const glm::mat4& viewMatrix)
+{
+	unsigned int liveCount = store.LiveCount();
+	if (sorter.NeedsSort(viewMatrix) || store.SlotVersion() != sortedSlots || sorter.Order().size() != liveCount)
+	{
+		sorter.Sort(store.PositionX(), store.PositionY(), store.PositionZ(), liveCount, viewMatrix);
+		sortedSlots = store.SlotVersion();
+	}
+	else if (!sortedDirty)
+	{
+		return;
+	}
 
+	// gather through the order so instances are drawn back to front
+	sortedInstance.resize(maxParticles * 4);
+	sortedColor.resize(maxParticles);
+	const std::vector<unsigned int>& order = sorter.Order();
+	const float* instance = store.InstanceData();
+	const unsigned int* color = store.ColorData();
+	for (unsigned int block = 0; block < 4; block++)
+	{
+		const float* source = instance + block * maxParticles;
+		float* target = &sortedInstance[block * maxParticles];
+		for (unsigned int i = 0; i < liveCount; i++)
+		{
+			target[i] = source[order[i]];
+		}
+	}
+	for (unsigned int i = 0; i < liveCount; i++)
+	{
+		sortedColor[i] = color[order[i]];
+	}
+	upload(sortedInstance.data(), sortedColor.data());
+	sortedDirty = false;
 }
 
 void ParticleSystem::Render(glm::mat4 viewMatrix, glm::mat4 projMatrix)
 {
+	if (depthSort)
+	{
+		sortForView(viewMatrix);
+	}
+
 	glUseProgram(shaderProgram);
 	glBindVertexArray(vao);
 	//set uniforms
@@ -116,26 +207,30 @@ void ParticleSystem::Render(glm::mat4 viewMatrix, glm::mat4 projMatrix)
 	glBindBuffer(GL_ARRAY_BUFFER, vbo_vertex);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
 
-	// 2nd attrib buffer positions of particle
+	// 2nd attrib buffer : particles' colors
 	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_position);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	// 3th attrib buffer : particles' colors
-	glEnableVertexAttribArray(2);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo_color);
-	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (void*)0);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (void*)0);
+
+	// 3th to 6th attrib buffers : x, y, z and scale blocks of the particles
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_position);
+	for (GLuint block = 0; block < 4; block++)
+	{
+		glEnableVertexAttribArray(2 + block);
+		glVertexAttribPointer(2 + block, 1, GL_FLOAT, GL_FALSE, 0, (void*)(block * maxParticles * sizeof(GLfloat)));
+		glVertexAttribDivisor(2 + block, 1);
+	}
 
 	glVertexAttribDivisor(0, 0);
 	glVertexAttribDivisor(1, 1);
-	glVertexAttribDivisor(2, 1);
 
 	// draw particles
-	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, maxParticles);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, store.LiveCount());
 
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
-	glDisableVertexAttribArray(2);
+	for (GLuint attribute = 0; attribute < 6; attribute++)
+	{
+		glDisableVertexAttribArray(attribute);
+	}
 
 	glBindVertexArray(0);
 }
@@ -144,8 +239,8 @@ ParticleSystem::ParticleSystem(unsigned int mp, glm::vec3 start)
 {
 	maxParticles = mp;
 	startPosition = start;
-	position_data = new GLfloat[maxParticles * 4];
-	color_data = new GLubyte[maxParticles * 4];
+	store.Reserve(maxParticles);
+	store.gravity = GRAVITY;
 }
 
 ParticleSystem::~ParticleSystem()
@@ -154,23 +249,6 @@ ParticleSystem::~ParticleSystem()
 	glDeleteBuffers(1, &vbo_color);
 	glDeleteBuffers(1, &vbo_position);
 	glDeleteBuffers(1, &vbo_vertex);
-	delete position_data;
-	delete color_data;
-}
-
-void ParticleSystem::setParticlesBuffer(unsigned int &currentParticle, unsigned int &particleCount)
-{
-	Particle& p = particles[currentParticle];
-	
-	position_data[4 * particleCount + 0] = p.position.x;
-	position_data[4 * particleCount + 1] = p.position.y;
-	position_data[4 * particleCount + 2] = p.position.z;
-	position_data[4 * particleCount + 3] = p.scale;
-
-	color_data[4 * particleCount + 0] = p.color.r;
-	color_data[4 * particleCount + 1] = p.color.g;
-	color_data[4 * particleCount + 2] = p.color.b;
-	color_data[4 * particleCount + 3] = p.color.a;
 }
 
 void ParticleSystem::loadShader()
@@ -180,8 +258,11 @@ void ParticleSystem::loadShader()
 		#version 330 core
 
 		layout (location = 0) in vec3 vert;
-		layout (location = 1) in vec4 position;
-		layout (location = 2) in vec4 color;
+		layout (location = 1) in vec4 color;
+		layout (location = 2) in float positionX;
+		layout (location = 3) in float positionY;
+		layout (location = 4) in float positionZ;
+		layout (location = 5) in float scale;
 		
 		uniform vec3 cameraUp;
 		uniform vec3 cameraRight;
@@ -193,9 +274,9 @@ void ParticleSystem::loadShader()
 		void main()
 		{			
 			vec3 vertexPosition = 
-				position.xyz
-				+ cameraRight * vert.x * position.w
-				+ cameraUp * vert.y * position.w;
+				vec3(positionX, positionY, positionZ)
+				+ cameraRight * vert.x * scale
+				+ cameraUp * vert.y * scale;
 
 			
 			gl_Position = vp * vec4(vertexPosition, 1.0f);
@@ -253,26 +334,18 @@ void ParticleSystem::checkErrorShader(GLuint shader) {
 	}
 }
 
-void ParticleSystem::generateParticles()
+void ParticleSystem::generateParticles(unsigned int first, unsigned int count)
 {
-	for (unsigned int i = 0; i < maxParticles; i++)
-	{
-		Particle newParticle;
-		newParticle.position = startPosition;
-		srand(time(0));
-		newParticle.velocity.x = ((((float)rand()/(float)RAND_MAX) * 2.0f) -1.0f) * PARTICLE_SPEED; // between -1 and 1 float
-		
-		newParticle.velocity.y = ((float)rand()/(float)RAND_MAX) * PARTICLE_SPEED; // only up not through floor
-		
-		newParticle.velocity.z = ((((float)rand()/(float) RAND_MAX) * 2.0f) - 1.0f) * PARTICLE_SPEED;  // between -1 and 1 float
-		
-		newParticle.scale = 100.0f; // between 1 and 1.5 float
-
-		newParticle.color.r = 1.0f;
-		newParticle.color.g = 1.0f;
-		newParticle.color.b = 1.0f;
-		newParticle.color.a = 1.0f;
-
-		particles.push_back(newParticle);
-	}
+	// bulk fills from this thread's stream, x and z between -1 and 1, y only up not through floor
+	Random& random = Random::ForThread();
+	random.FillUniform(store.VelocityX() + first, count, -PARTICLE_SPEED, PARTICLE_SPEED);
+	random.FillUniform(store.VelocityY() + first, count, 0.0f, PARTICLE_SPEED);
+	random.FillUniform(store.VelocityZ() + first, count, -PARTICLE_SPEED, PARTICLE_SPEED);
+
+	std::fill_n(store.PositionX() + first, count, startPosition.x);
+	std::fill_n(store.PositionY() + first, count, startPosition.y);
+	std::fill_n(store.PositionZ() + first, count, startPosition.z);
+	std::fill_n(store.Scale() + first, count, 100.0f);
+	std::fill_n(store.Color() + first, count, 0xffffffffu); // white, opaque
+	std::fill_n(store.Life() + first, count, particleLife);
 }
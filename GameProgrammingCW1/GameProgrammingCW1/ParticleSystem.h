@@ -7,24 +7,38 @@
 #include <GLFW/glfw3.h>
 #include <vector>
 
-struct Particle
-{
-	glm::vec3 position;
-	glm::vec3 velocity;
-	glm::vec4 color;
-	float lifeTime;
-	float rotation;
-	float scale;
-};
-
+#include "ParticleStore.h"
+#include "DepthSorter.h"
+
+// Emitter with a fixed pool of maxParticles kept in a ParticleStore. Only the
+// live particles are simulated, uploaded and drawn, the position buffer is
+// the store's x | y | z | scale blocks uploaded as they are. UpdateAll steps
+// many emitters with their chunks shared across the worker threads.
+// With depthSort the particles are uploaded back to front in Render. The
+// order is sorted again when particles spawned or died (their slots hold other
+// particles now) or the camera or the fastest particle has moved the sorter's
+// sortDistance, otherwise the old order is reused with the new positions.
 class ParticleSystem
 {
 public:
 	void Init();
 	void Update(float delta);
+	static void UpdateAll(const std::vector<ParticleSystem*>& systems, float delta, ThreadPool* pool);
 	void UpdateBuffers();
 	void Render(glm::mat4 viewMatrix, glm::mat4 projMatrix);
 
+	// spawns up to count particles, fewer when the pool is full
+	void Emit(unsigned int count);
+	unsigned int LiveCount() const { return store.LiveCount(); }
+
+	// null simulates on the calling thread only
+	void SetThreadPool(ThreadPool* pool) { store.SetThreadPool(pool); sorter.SetThreadPool(pool); }
+
+	float spawnRate = 0.0f;			// particles per second emitted by Update
+	float particleLife = 2.0f;		// seconds
+	float drag = 0.2f;				// fraction of velocity lost per second
+	bool depthSort = false;			// draw back to front, for blending that depends on order
+
 	ParticleSystem(unsigned int mp, glm::vec3 start);
 	~ParticleSystem();
 private:
@@ -35,7 +49,13 @@ private:
 	const float PARTICLE_MASS = 1.0f;
 	const float PARTICLE_SPEED = 3.0f;
 
-	std::vector<Particle> particles;
+	ParticleStore store;
+
+	DepthSorter sorter;
+	bool sortedDirty = true;		// particles changed since the sorted upload
+	unsigned int sortedSlots = 0;	// store SlotVersion the order was sorted for
+	std::vector<float> sortedInstance;
+	std::vector<unsigned int> sortedColor;
 
 	static const GLfloat quad_buffer_data[];
 
@@ -52,16 +72,16 @@ private:
 	GLuint texture;
 
 	unsigned int maxParticles;
-	unsigned int particleTexture;
+	float spawnDebt = 0.0f;			// fraction of a particle owed to spawnRate
 
-	GLfloat* position_data;
-	GLubyte* color_data;
-
-	void setParticlesBuffer(unsigned int &currentParticle, unsigned int &particleCount);
+	void spawnDue(float delta);
+	void upload(const float* instance, const unsigned int* color);
+	void sortForView(const glm::mat4& viewMatrix);
+	unsigned int particleTexture;
 
 	void loadShader();
 	void checkErrorShader(GLuint shader);
-	void generateParticles();
+	void generateParticles(unsigned int first, unsigned int count);
 };
 
 #endif // !PARTICLE_SYSTEM_HPP
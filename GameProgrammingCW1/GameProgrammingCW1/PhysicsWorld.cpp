@@ -0,0 +1,364 @@
+#include "PhysicsWorld.h"
+#include "SimdFloat.h"
+#include <algorithm>
+#include <cmath>
+
+static const float SKIN = 1e-4f;
+
+PhysicsWorld::PhysicsWorld()
+{
+}
+
+PhysicsWorld::~PhysicsWorld()
+{
+}
+
+BodyHandle PhysicsWorld::Add(const Body& body)
+{
+	unsigned int i = count++;
+
+	positionX.push_back(body.position.x);
+	positionY.push_back(body.position.y);
+	positionZ.push_back(body.position.z);
+	previousX.push_back(body.position.x);
+	previousY.push_back(body.position.y);
+	previousZ.push_back(body.position.z);
+	velocityX.push_back(body.velocity.x);
+	velocityY.push_back(body.velocity.y);
+	velocityZ.push_back(body.velocity.z);
+	accelerationX.push_back(body.acceleration.x);
+	accelerationY.push_back(body.acceleration.y);
+	accelerationZ.push_back(body.acceleration.z);
+	forceX.push_back(body.addedForce.x);
+	forceY.push_back(body.addedForce.y);
+	forceZ.push_back(body.addedForce.z);
+	halfX.push_back(body.scale.x / 2);
+	halfZ.push_back(body.scale.z / 2);
+	topSpeed.push_back(body.topSpeed);
+	dynamic.push_back(body.isStatic ? 0.0f : 1.0f);
+	colliding.push_back(body.isColliding ? 1.0f : 0.0f);
+	awake.push_back(1.0f);
+	restTime.push_back(0.0f);
+
+	left.push_back(0.0f);
+	right.push_back(0.0f);
+	down.push_back(0.0f);
+	up.push_back(0.0f);
+
+	scale.push_back(body.scale);
+	direction.push_back((float)(int)body.direction);
+	isBoid.push_back(body.isBoid ? 1 : 0);
+
+	updateSides(i);
+	return BodyHandle(this, i);
+}
+
+void PhysicsWorld::Clear()
+{
+	count = 0;
+	forEachArray(*this, [](std::vector<float>& array) { array.clear(); });
+	scale.clear();
+	isBoid.clear();
+	contacts.clear();
+}
+
+void PhysicsWorld::Save(Snapshot& snapshot) const
+{
+	snapshot.Write(count);
+	forEachArray(*this, [&](const std::vector<float>& array) { snapshot.Write(array); });
+	snapshot.Write(scale);
+	snapshot.Write(isBoid);
+	snapshot.Write(contacts);
+}
+
+void PhysicsWorld::Load(SnapshotReader& reader)
+{
+	reader.Read(count);
+	forEachArray(*this, [&](std::vector<float>& array) { reader.Read(array); });
+	reader.Read(scale);
+	reader.Read(isBoid);
+	reader.Read(contacts);
+}
+
+void PhysicsWorld::SetPosition(unsigned int i, glm::vec3 position)
+{
+	positionX[i] = position.x;
+	positionY[i] = position.y;
+	positionZ[i] = position.z;
+	previousX[i] = position.x;
+	previousY[i] = position.y;
+	previousZ[i] = position.z;
+	updateSides(i);
+	Wake(i);
+}
+
+glm::vec3 PhysicsWorld::InterpolatedPosition(unsigned int i, float alpha) const
+{
+	return glm::mix(glm::vec3(previousX[i], previousY[i], previousZ[i]), Position(i), alpha);
+}
+
+void PhysicsWorld::SetVelocity(unsigned int i, glm::vec3 velocity)
+{
+	velocityX[i] = velocity.x;
+	velocityY[i] = velocity.y;
+	velocityZ[i] = velocity.z;
+	Wake(i);
+}
+
+void PhysicsWorld::SetAcceleration(unsigned int i, glm::vec3 acceleration)
+{
+	accelerationX[i] = acceleration.x;
+	accelerationY[i] = acceleration.y;
+	accelerationZ[i] = acceleration.z;
+	Wake(i);
+}
+
+void PhysicsWorld::SetAddedForce(unsigned int i, glm::vec3 force)
+{
+	forceX[i] = force.x;
+	forceY[i] = force.y;
+	forceZ[i] = force.z;
+	Wake(i);
+}
+
+void PhysicsWorld::Wake(unsigned int i)
+{
+	awake[i] = 1.0f;
+	restTime[i] = 0.0f;
+}
+
+void PhysicsWorld::AddContact(unsigned int a, unsigned int b)
+{
+	contacts.push_back(a);
+	contacts.push_back(b);
+}
+
+void PhysicsWorld::Step(float deltaTime)
+{
+	// blocks where every body is static or asleep are skipped whole, they
+	// only need the previous position to catch up
+	for (unsigned int begin = 0; begin < count; begin += BLOCK_SIZE)
+	{
+		unsigned int end = std::min(begin + BLOCK_SIZE, count);
+		float active = 0.0f;
+		for (unsigned int i = begin; i < end; i++)
+		{
+			active += dynamic[i] * awake[i];
+		}
+		if (active > 0.0f)
+		{
+			integrate(begin, end, deltaTime);
+		}
+		else
+		{
+			std::copy(&positionX[begin], &positionX[begin] + (end - begin), &previousX[begin]);
+			std::copy(&positionY[begin], &positionY[begin] + (end - begin), &previousY[begin]);
+			std::copy(&positionZ[begin], &positionZ[begin] + (end - begin), &previousZ[begin]);
+		}
+	}
+	sweepFastBodies();
+	updateSleeping();
+	contacts.clear();
+}
+
+void PhysicsWorld::integrate(unsigned int begin, unsigned int end, float deltaTime)
+{
+	RunKernel(begin, end, [&](unsigned int i, auto lane)
+	{
+		typedef decltype(lane) F;
+		F zero(0.0f);
+		F active = F::Load(&dynamic[i]) * F::Load(&awake[i]);
+		F dt = F(deltaTime) * active;
+		F top = F::Load(&topSpeed[i]);
+		F bottom = zero - top;
+
+		// statics and sleeping bodies keep their velocity, they never accelerate
+		// and are not clamped to their top speed
+		auto awakeDynamic = zero < active;
+		F ax = F::Load(&accelerationX[i]);
+		F ay = F::Load(&accelerationY[i]);
+		F az = F::Load(&accelerationZ[i]);
+		F vx = F::Load(&velocityX[i]);
+		F vy = F::Load(&velocityY[i]);
+		F vz = F::Load(&velocityZ[i]);
+		vx = Select(awakeDynamic, Min(Max(vx + ax * active, bottom), top), vx);
+		vy = Select(awakeDynamic, Min(Max(vy + ay * active, bottom), top), vy);
+		vz = Select(awakeDynamic, Min(Max(vz + az * active, bottom), top), vz);
+		vx.Store(&velocityX[i]);
+		vy.Store(&velocityY[i]);
+		vz.Store(&velocityZ[i]);
+
+		F fx = F::Load(&forceX[i]);
+		F fy = F::Load(&forceY[i]);
+		F fz = F::Load(&forceZ[i]);
+
+		F px = F::Load(&positionX[i]);
+		F py = F::Load(&positionY[i]);
+		F pz = F::Load(&positionZ[i]);
+		px.Store(&previousX[i]);
+		py.Store(&previousY[i]);
+		pz.Store(&previousZ[i]);
+
+		px = px + (vx + fx) * dt;
+		py = py + (vy + fy) * dt;
+		pz = pz + (vz + fz) * dt;
+		px.Store(&positionX[i]);
+		py.Store(&positionY[i]);
+		pz.Store(&positionZ[i]);
+
+		F hx = F::Load(&halfX[i]);
+		F hz = F::Load(&halfZ[i]);
+		(px - hx).Store(&left[i]);
+		(px + hx).Store(&right[i]);
+		(pz - hz).Store(&down[i]);
+		(pz + hz).Store(&up[i]);
+
+		// the push only lasts while colliding
+		auto keep = zero < F::Load(&colliding[i]);
+		Mask(keep, fx).Store(&forceX[i]);
+		Mask(keep, fy).Store(&forceY[i]);
+		Mask(keep, fz).Store(&forceZ[i]);
+
+		// same priorities as Body::CalculateDirection, the last test wins, and
+		// colliding or resting bodies keep theirs
+		F heading = F::Load(&direction[i]);
+		auto moving = And(F::Load(&colliding[i]) < F(0.5f), zero < active);
+		heading = Select(And(moving, vz < zero), F((float)(int)Direction::Down), heading);
+		heading = Select(And(moving, zero < vz), F((float)(int)Direction::Up), heading);
+		heading = Select(And(moving, vx < zero), F((float)(int)Direction::Right), heading);
+		heading = Select(And(moving, zero < vx), F((float)(int)Direction::Left), heading);
+		heading.Store(&direction[i]);
+
+		// at rest while neither moving nor being pushed or accelerated
+		F mx = vx + fx;
+		F my = vy + fy;
+		F mz = vz + fz;
+		F limit(sleepVelocity * sleepVelocity);
+		auto resting = And(mx * mx + my * my + mz * mz < limit, ax * ax + ay * ay + az * az < limit);
+		Select(resting, F::Load(&restTime[i]) + F(deltaTime), zero).Store(&restTime[i]);
+	});
+}
+
+// the discrete test can miss a wall a body moved across, redo the move from
+// the previous position up to the first wall and slide along it
+void PhysicsWorld::sweepFastBodies()
+{
+	if (staticTiles == nullptr)
+		return;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float dx = positionX[i] - previousX[i];
+		float dz = positionZ[i] - previousZ[i];
+		if (std::fabs(dx) <= halfX[i] && std::fabs(dz) <= halfZ[i])
+			continue;
+
+		float x = previousX[i];
+		float z = previousZ[i];
+		for (int slide = 0; slide < MAX_SLIDES; slide++)
+		{
+			Aabb box(x - halfX[i], x + halfX[i], z - halfZ[i], z + halfZ[i]);
+			float time, normalX, normalZ;
+			if (!staticTiles->Sweep(box, dx, dz, time, normalX, normalZ))
+			{
+				x += dx;
+				z += dz;
+				break;
+			}
+
+			// stop a hair before the wall, keep only the move along it
+			x += dx * time + normalX * SKIN;
+			z += dz * time + normalZ * SKIN;
+			dx *= (1.0f - time) * (1.0f - std::fabs(normalX));
+			dz *= (1.0f - time) * (1.0f - std::fabs(normalZ));
+			if (normalX != 0.0f) velocityX[i] = 0.0f;
+			if (normalZ != 0.0f) velocityZ[i] = 0.0f;
+		}
+
+		positionX[i] = x;
+		positionZ[i] = z;
+		updateSides(i);
+	}
+}
+
+// an island sleeps once its least rested body has rested for sleepTime,
+// otherwise every body in it is awake
+void PhysicsWorld::updateSleeping()
+{
+	if (!allowSleep)
+		return;
+
+	// without contacts every body is its own island
+	if (contacts.empty())
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			setSleeping(i, restTime[i] >= sleepTime);
+		}
+		return;
+	}
+
+	island.resize(count);
+	islandRestTime.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		island[i] = i;
+		islandRestTime[i] = restTime[i];
+	}
+
+	// statics do not join islands, they would connect everything resting on them
+	for (unsigned int c = 0; c < contacts.size(); c += 2)
+	{
+		unsigned int a = contacts[c];
+		unsigned int b = contacts[c + 1];
+		if (dynamic[a] == 0.0f || dynamic[b] == 0.0f)
+			continue;
+		island[findIsland(a)] = findIsland(b);
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int root = findIsland(i);
+		islandRestTime[root] = std::min(islandRestTime[root], restTime[i]);
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		setSleeping(i, islandRestTime[findIsland(i)] >= sleepTime);
+	}
+}
+
+void PhysicsWorld::setSleeping(unsigned int i, bool sleep)
+{
+	if (dynamic[i] == 0.0f || sleep == (awake[i] == 0.0f))
+		return;
+
+	if (sleep)
+	{
+		awake[i] = 0.0f;
+		velocityX[i] = velocityY[i] = velocityZ[i] = 0.0f;
+		forceX[i] = forceY[i] = forceZ[i] = 0.0f;
+	}
+	else
+	{
+		Wake(i);
+	}
+}
+
+unsigned int PhysicsWorld::findIsland(unsigned int i)
+{
+	while (island[i] != i)
+	{
+		island[i] = island[island[i]];
+		i = island[i];
+	}
+	return i;
+}
+
+void PhysicsWorld::updateSides(unsigned int i)
+{
+	left[i] = positionX[i] - halfX[i];
+	right[i] = positionX[i] + halfX[i];
+	down[i] = positionZ[i] - halfZ[i];
+	up[i] = positionZ[i] + halfZ[i];
+}
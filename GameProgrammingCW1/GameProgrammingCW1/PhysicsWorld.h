@@ -0,0 +1,178 @@
+#ifndef PHYSICS_WORLD_H
+#define PHYSICS_WORLD_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Body.h"
+#include "Aabb.h"
+#include "TileMap.h"
+#include "Snapshot.h"
+
+class PhysicsWorld;
+
+// Lightweight reference to a body simulated by a PhysicsWorld, the state
+// itself lives in the world's arrays. Stays valid while the world exists.
+class BodyHandle
+{
+public:
+	BodyHandle() : world(nullptr), index(0) {}
+	BodyHandle(PhysicsWorld* world, unsigned int index) : world(world), index(index) {}
+
+	unsigned int Index() const { return index; }
+
+	inline glm::vec3 Position() const;
+	inline glm::vec3 InterpolatedPosition(float alpha) const;
+	inline void SetPosition(glm::vec3 position);
+	inline glm::vec3 Velocity() const;
+	inline void SetVelocity(glm::vec3 velocity);
+	inline glm::vec3 Acceleration() const;
+	inline void SetAcceleration(glm::vec3 acceleration);
+	inline glm::vec3 AddedForce() const;
+	inline void SetAddedForce(glm::vec3 force);
+	inline glm::vec3 Scale() const;
+	inline Aabb Box() const;
+	inline Direction MoveDirection() const;
+	inline bool IsColliding() const;
+	inline void SetColliding(bool colliding);
+	inline bool IsBoid() const;
+	inline bool IsStatic() const;
+	inline bool IsSleeping() const;
+	inline void Wake();
+
+private:
+	PhysicsWorld* world;
+	unsigned int index;
+};
+
+// Body state stored as structure of arrays. Step integrates every body in one
+// pass on SimdFloat lanes: top speed clamps are min/max instead of branches and
+// static and sleeping bodies are masked out rather than skipped.
+// Bodies touching each other (AddContact) form islands. An island falls asleep
+// once all of its bodies have been at rest for sleepTime, and wakes as a whole
+// when one of them moves again. Setting a body's position, velocity,
+// acceleration or force wakes it.
+// Bodies that move further than half their size in a step are swept against
+// the static tiles, so they stop at walls they would otherwise step over.
+// A Body is only the description a body is created from.
+class PhysicsWorld
+{
+public:
+	PhysicsWorld();
+	~PhysicsWorld();
+
+	BodyHandle Add(const Body& body);
+	void Clear();
+
+	// every body array and the pending contacts, handles stay valid as long as
+	// the loaded snapshot has at least as many bodies
+	void Save(Snapshot& snapshot) const;
+	void Load(SnapshotReader& reader);
+
+	// same as Body::Update for every body, sides are computed after moving
+	void Step(float deltaTime);
+
+	// walls fast bodies are swept against, not owned
+	void SetStaticGeometry(const TileMap* tiles) { staticTiles = tiles; }
+
+	// bodies touching this step, read by the next Step to build islands
+	void AddContact(unsigned int a, unsigned int b);
+
+	unsigned int Size() const { return count; }
+
+	glm::vec3 Position(unsigned int i) const { return glm::vec3(positionX[i], positionY[i], positionZ[i]); }
+	// teleports, the body is not interpolated from its old position
+	void SetPosition(unsigned int i, glm::vec3 position);
+	// between the position before the last Step (0) and after it (1)
+	glm::vec3 InterpolatedPosition(unsigned int i, float alpha) const;
+	glm::vec3 Velocity(unsigned int i) const { return glm::vec3(velocityX[i], velocityY[i], velocityZ[i]); }
+	void SetVelocity(unsigned int i, glm::vec3 velocity);
+	glm::vec3 Acceleration(unsigned int i) const { return glm::vec3(accelerationX[i], accelerationY[i], accelerationZ[i]); }
+	void SetAcceleration(unsigned int i, glm::vec3 acceleration);
+	glm::vec3 AddedForce(unsigned int i) const { return glm::vec3(forceX[i], forceY[i], forceZ[i]); }
+	void SetAddedForce(unsigned int i, glm::vec3 force);
+	glm::vec3 Scale(unsigned int i) const { return scale[i]; }
+	Aabb Box(unsigned int i) const { return Aabb(left[i], right[i], down[i], up[i]); }
+	Direction MoveDirection(unsigned int i) const { return (Direction)(int)direction[i]; }
+	bool IsColliding(unsigned int i) const { return colliding[i] > 0.0f; }
+	void SetColliding(unsigned int i, bool isColliding) { colliding[i] = isColliding ? 1.0f : 0.0f; }
+	bool IsBoid(unsigned int i) const { return isBoid[i] != 0; }
+	bool IsStatic(unsigned int i) const { return dynamic[i] == 0.0f; }
+	bool IsSleeping(unsigned int i) const { return dynamic[i] != 0.0f && awake[i] == 0.0f; }
+	void Wake(unsigned int i);
+
+	bool allowSleep = true;
+	float sleepVelocity = 0.01f;	// speed and acceleration below this are at rest
+	float sleepTime = 0.5f;			// seconds at rest before an island sleeps
+
+private:
+	static const unsigned int BLOCK_SIZE = 64;
+	static const int MAX_SLIDES = 3;
+
+	unsigned int count = 0;
+	const TileMap* staticTiles = nullptr;
+
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> previousX, previousY, previousZ;	// before the last Step
+	std::vector<float> velocityX, velocityY, velocityZ;
+	std::vector<float> accelerationX, accelerationY, accelerationZ;
+	std::vector<float> forceX, forceY, forceZ;		// Body::addedForce
+	std::vector<float> halfX, halfZ;
+	std::vector<float> topSpeed;
+	std::vector<float> dynamic;						// 0.0 for static bodies
+	std::vector<float> colliding;					// 1.0 while colliding
+	std::vector<float> awake;						// 0.0 while sleeping
+	std::vector<float> restTime;					// seconds at rest
+	std::vector<float> direction;					// Direction value, set in the kernel
+
+	std::vector<float> left, right, down, up;
+
+	std::vector<glm::vec3> scale;
+	std::vector<unsigned char> isBoid;
+
+	std::vector<unsigned int> contacts;				// pairs of body indices
+	std::vector<unsigned int> island;				// union-find parent
+	std::vector<float> islandRestTime;
+
+	// calls visit on every per body array
+	template <typename Self, typename Visit>
+	static void forEachArray(Self& self, Visit visit)
+	{
+		for (auto* array : { &self.positionX, &self.positionY, &self.positionZ, &self.previousX, &self.previousY, &self.previousZ,
+			&self.velocityX, &self.velocityY, &self.velocityZ, &self.accelerationX, &self.accelerationY, &self.accelerationZ,
+			&self.forceX, &self.forceY, &self.forceZ, &self.halfX, &self.halfZ, &self.topSpeed, &self.dynamic, &self.colliding,
+			&self.awake, &self.restTime, &self.direction, &self.left, &self.right, &self.down, &self.up })
+		{
+			visit(*array);
+		}
+	}
+
+	void integrate(unsigned int begin, unsigned int end, float deltaTime);
+	void sweepFastBodies();
+	void updateSleeping();
+	void setSleeping(unsigned int i, bool sleep);
+	unsigned int findIsland(unsigned int i);
+	void updateSides(unsigned int i);
+};
+
+glm::vec3 BodyHandle::Position() const { return world->Position(index); }
+glm::vec3 BodyHandle::InterpolatedPosition(float alpha) const { return world->InterpolatedPosition(index, alpha); }
+void BodyHandle::SetPosition(glm::vec3 position) { world->SetPosition(index, position); }
+glm::vec3 BodyHandle::Velocity() const { return world->Velocity(index); }
+void BodyHandle::SetVelocity(glm::vec3 velocity) { world->SetVelocity(index, velocity); }
+glm::vec3 BodyHandle::Acceleration() const { return world->Acceleration(index); }
+void BodyHandle::SetAcceleration(glm::vec3 acceleration) { world->SetAcceleration(index, acceleration); }
+glm::vec3 BodyHandle::AddedForce() const { return world->AddedForce(index); }
+void BodyHandle::SetAddedForce(glm::vec3 force) { world->SetAddedForce(index, force); }
+glm::vec3 BodyHandle::Scale() const { return world->Scale(index); }
+Aabb BodyHandle::Box() const { return world->Box(index); }
+Direction BodyHandle::MoveDirection() const { return world->MoveDirection(index); }
+bool BodyHandle::IsColliding() const { return world->IsColliding(index); }
+void BodyHandle::SetColliding(bool colliding) { world->SetColliding(index, colliding); }
+bool BodyHandle::IsBoid() const { return world->IsBoid(index); }
+bool BodyHandle::IsStatic() const { return world->IsStatic(index); }
+bool BodyHandle::IsSleeping() const { return world->IsSleeping(index); }
+void BodyHandle::Wake() { world->Wake(index); }
+
+#endif // !PHYSICS_WORLD_H
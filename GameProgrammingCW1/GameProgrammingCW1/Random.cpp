@@ -0,0 +1,175 @@
+#include "Random.h"
+#include "SimdFloat.h"
+#include <atomic>
+
+static inline unsigned int rotl(unsigned int x, int k)
+{
+	return (x << k) | (x >> (32 - k));
+}
+
+// spreads one seed over the generator words
+static unsigned long long splitMix(unsigned long long& x)
+{
+	unsigned long long z = (x += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+Random::Random(unsigned long long seed, unsigned int stream)
+{
+	Seed(seed, stream);
+}
+
+void Random::Seed(unsigned long long seed, unsigned int stream)
+{
+	unsigned long long x = seed ^ (0xd1b54a32d192ed03ull * (stream + 1ull));
+	for (int word = 0; word < 4; word += 2)
+	{
+		unsigned long long z = splitMix(x);
+		state[word] = (unsigned int)z;
+		state[word + 1] = (unsigned int)(z >> 32);
+	}
+	for (unsigned int lane = 0; lane < LANES; lane++)
+	{
+		for (int word = 0; word < 4; word += 2)
+		{
+			unsigned long long z = splitMix(x);
+			lanes[word][lane] = (unsigned int)z;
+			lanes[word + 1][lane] = (unsigned int)(z >> 32);
+		}
+	}
+}
+
+unsigned int Random::NextUInt()
+{
+	unsigned int result = state[0] + state[3];
+	unsigned int t = state[1] << 9;
+
+	state[2] ^= state[0];
+	state[3] ^= state[1];
+	state[1] ^= state[2];
+	state[0] ^= state[3];
+	state[2] ^= t;
+	state[3] = rotl(state[3], 11);
+
+	return result;
+}
+
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+
+// one xoshiro128+ step on four lanes, returns the floats in [0, 1) scaled and offset
+static inline __m128 stepLanes(__m128i& s0, __m128i& s1, __m128i& s2, __m128i& s3, __m128 scale, __m128 min)
+{
+	__m128i result = _mm_add_epi32(s0, s3);
+	__m128i t = _mm_slli_epi32(s1, 9);
+	s2 = _mm_xor_si128(s2, s0);
+	s3 = _mm_xor_si128(s3, s1);
+	s1 = _mm_xor_si128(s1, s2);
+	s0 = _mm_xor_si128(s0, s3);
+	s2 = _mm_xor_si128(s2, t);
+	s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+	__m128 value = _mm_cvtepi32_ps(_mm_srli_epi32(result, 8));
+	return _mm_add_ps(min, _mm_mul_ps(value, scale));
+}
+
+void Random::FillUniform(float* out, unsigned int count, float min, float max)
+{
+	__m128 scale = _mm_set1_ps((max - min) * (1.0f / 16777216.0f));
+	__m128 offset = _mm_set1_ps(min);
+	__m128i a0 = _mm_loadu_si128((const __m128i*)&lanes[0][0]), b0 = _mm_loadu_si128((const __m128i*)&lanes[0][4]);
+	__m128i a1 = _mm_loadu_si128((const __m128i*)&lanes[1][0]), b1 = _mm_loadu_si128((const __m128i*)&lanes[1][4]);
+	__m128i a2 = _mm_loadu_si128((const __m128i*)&lanes[2][0]), b2 = _mm_loadu_si128((const __m128i*)&lanes[2][4]);
+	__m128i a3 = _mm_loadu_si128((const __m128i*)&lanes[3][0]), b3 = _mm_loadu_si128((const __m128i*)&lanes[3][4]);
+
+	// two independent groups of four lanes keep both dependency chains busy
+	unsigned int i = 0;
+	for (; i + LANES <= count; i += LANES)
+	{
+		_mm_storeu_ps(out + i, stepLanes(a0, a1, a2, a3, scale, offset));
+		_mm_storeu_ps(out + i + 4, stepLanes(b0, b1, b2, b3, scale, offset));
+	}
+
+	_mm_storeu_si128((__m128i*)&lanes[0][0], a0); _mm_storeu_si128((__m128i*)&lanes[0][4], b0);
+	_mm_storeu_si128((__m128i*)&lanes[1][0], a1); _mm_storeu_si128((__m128i*)&lanes[1][4], b1);
+	_mm_storeu_si128((__m128i*)&lanes[2][0], a2); _mm_storeu_si128((__m128i*)&lanes[2][4], b2);
+	_mm_storeu_si128((__m128i*)&lanes[3][0], a3); _mm_storeu_si128((__m128i*)&lanes[3][4], b3);
+	for (; i < count; i++)
+	{
+		out[i] = Range(min, max);
+	}
+}
+
+#else
+
+void Random::FillUniform(float* out, unsigned int count, float min, float max)
+{
+	unsigned int (&s0)[LANES] = lanes[0];
+	unsigned int (&s1)[LANES] = lanes[1];
+	unsigned int (&s2)[LANES] = lanes[2];
+	unsigned int (&s3)[LANES] = lanes[3];
+
+	float scale = (max - min) * (1.0f / 16777216.0f);
+	unsigned int i = 0;
+	for (; i + LANES <= count; i += LANES)
+	{
+		for (unsigned int lane = 0; lane < LANES; lane++)
+		{
+			unsigned int result = s0[lane] + s3[lane];
+			unsigned int t = s1[lane] << 9;
+			s2[lane] ^= s0[lane];
+			s3[lane] ^= s1[lane];
+			s1[lane] ^= s2[lane];
+			s0[lane] ^= s3[lane];
+			s2[lane] ^= t;
+			s3[lane] = rotl(s3[lane], 11);
+			out[i + lane] = min + (float)(result >> 8) * scale;
+		}
+	}
+	for (; i < count; i++)
+	{
+		out[i] = Range(min, max);
+	}
+}
+
+#endif
+
+// parabola sine with one refinement step, within 0.001 on [-pi, pi]
+template<typename F>
+static inline F fastSin(F x)
+{
+	F y = F(1.27323954f) * x - F(0.405284735f) * x * Abs(x);
+	return F(0.225f) * (y * Abs(y) - y) + y;
+}
+
+void Random::FillDirection(float* x, float* y, float* z, unsigned int count)
+{
+	// uniform height and angle around it give an even spread (Archimedes),
+	// x holds the angle until it is replaced
+	const float pi = 3.14159265f;
+	FillUniform(y, count, -1.0f, 1.0f);
+	FillUniform(x, count, -pi, pi);
+	RunKernel(0, count, [&](unsigned int i, auto lane)
+	{
+		typedef decltype(lane) F;
+		F height = F::Load(y + i);
+		F angle = F::Load(x + i);
+		F quarter = angle + F(pi * 0.5f);
+		quarter = Select(F(pi) < quarter, quarter - F(2.0f * pi), quarter);
+
+		// the approximations are renormalised so the result is always unit length
+		F sine = fastSin(angle);
+		F cosine = fastSin(quarter);
+		F radius = Sqrt(Max(F(1.0f) - height * height, F(0.0f)));
+		F scale = radius / Sqrt(sine * sine + cosine * cosine);
+		(cosine * scale).Store(x + i);
+		(sine * scale).Store(z + i);
+	});
+}
+
+Random& Random::ForThread()
+{
+	static std::atomic<unsigned int> nextStream(0);
+	thread_local Random random(0x2545f4914f6cdd1dull, nextStream++);
+	return random;
+}
@@ -0,0 +1,38 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+// xoshiro128+ generator, small and fast with a period of 2^128 - 1.
+// Streams seeded with different stream numbers are independent, ForThread
+// gives every thread its own so nothing is shared or locked.
+// The Fill functions run LANES generators side by side in SSE2 registers
+// (plain lane loops without it), so bulk samples cost a few times a memset
+// of the output instead of a call per number.
+class Random
+{
+public:
+	Random(unsigned long long seed = 0x2545f4914f6cdd1dull, unsigned int stream = 0);
+
+	void Seed(unsigned long long seed, unsigned int stream);
+
+	unsigned int NextUInt();
+	// [0, 1)
+	float NextFloat() { return (NextUInt() >> 8) * (1.0f / 16777216.0f); }
+	// [min, max)
+	float Range(float min, float max) { return min + (max - min) * NextFloat(); }
+
+	// count samples in [min, max)
+	void FillUniform(float* out, unsigned int count, float min, float max);
+	// count unit vectors spread evenly over the sphere
+	void FillDirection(float* x, float* y, float* z, unsigned int count);
+
+	// this thread's stream, seeded the first time a thread asks for it
+	static Random& ForThread();
+
+private:
+	static const unsigned int LANES = 8;
+
+	unsigned int state[4];
+	unsigned int lanes[4][LANES];		// bulk generators, lanes[word][lane]
+};
+
+#endif // !RANDOM_H
@@ -5,6 +5,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 
 Shapes::Shapes() {
@@ -239,6 +240,97 @@ void Shapes::LoadInstanced(glm::mat4* models, const int num)
 	glBindVertexArray(0);	// Unbind
 }
 
+void Shapes::LoadCompactInstanced(const CompactInstance* instances, const int num)
+{
+	const char* vs_source[] = { R"(
+		#version 330 core
+
+		layout (location = 0) in vec3 position;
+		layout (location = 1) in vec4 position_scale;	// per instance
+		layout (location = 2) in vec4 rotation;			// per instance quaternion
+
+		uniform mat4 view_matrix;
+		uniform mat4 proj_matrix;
+		
+		void main(void)
+		{
+			vec3 scaled = position * position_scale.w;
+			vec3 rotated = scaled + 2.0f * cross(rotation.xyz, cross(rotation.xyz, scaled) + rotation.w * scaled);
+			gl_Position = proj_matrix * view_matrix * vec4(rotated + position_scale.xyz, 1.0f);
+		}
+)" };
+
+
+	const char* fs_source[] = { R"(
+		#version 330 core
+
+		uniform vec4 inColor;
+		out vec4 color;
+
+		void main(void)
+		{
+			color = inColor;
+		}
+)" };
+
+#pragma region Shader Loading
+	program = glCreateProgram();
+	GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fs, 1, fs_source, NULL);
+	glCompileShader(fs);
+	checkErrorShader(fs);
+
+	GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vs, 1, vs_source, NULL);
+	glCompileShader(vs);
+	checkErrorShader(vs);
+
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+
+	glLinkProgram(program);
+
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+#pragma endregion
+
+
+	view_location = glGetUniformLocation(program, "view_matrix");
+	proj_location = glGetUniformLocation(program, "proj_matrix");
+	color_location = glGetUniformLocation(program, "inColor");
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	
+	glGenBuffers(1, &vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertexPositions.size() * sizeof(GLfloat), &vertexPositions[0], GL_STATIC_DRAW);
+	
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+	
+
+	glGenBuffers(1, &model_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, model_buffer);
+	glBufferData(GL_ARRAY_BUFFER, num * sizeof(CompactInstance), &instances[0], GL_STREAM_DRAW);
+
+	// position and scale as floats, the quaternion normalised back from shorts
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(CompactInstance), (void*)0);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_SHORT, GL_TRUE, sizeof(CompactInstance), (void*)(sizeof(glm::vec4)));
+
+	glVertexAttribDivisor(1, 1);
+	glVertexAttribDivisor(2, 1);
+	instanceAttributes = 2;
+
+	glLinkProgram(0);	// unlink
+	glDisableVertexAttribArray(0); // Disable
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+	glBindVertexArray(0);	// Unbind
+}
+
 void Shapes::Draw() {
 	glUseProgram(program);
 	glBindVertexArray(vao);
@@ -262,11 +354,10 @@ void Shapes::DrawInstanced(const int numInstances)
 {
 	glUseProgram(program);
 	glBindVertexArray(vao);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glEnableVertexAttribArray(3);
-	glEnableVertexAttribArray(4);
+	for (int attribute = 0; attribute <= instanceAttributes; attribute++)
+	{
+		glEnableVertexAttribArray(attribute);
+	}
 
 
 
@@ -285,11 +376,10 @@ void Shapes::DrawInstanced(const int numInstances)
 
 	
 
-	glDisableVertexAttribArray(0); // Disable
-	glDisableVertexAttribArray(1);
-	glDisableVertexAttribArray(2);
-	glDisableVertexAttribArray(3);
-	glDisableVertexAttribArray(4);
+	for (int attribute = 0; attribute <= instanceAttributes; attribute++)
+	{
+		glDisableVertexAttribArray(attribute); // Disable
+	}
 
 }
 
@@ -300,6 +390,23 @@ void Shapes::UpdateModelBuffer(glm::mat4* models, const int num)
 	glBufferSubData(GL_ARRAY_BUFFER,0, num * sizeof(glm::mat4), &models[0]);
 }
 
+void Shapes::UpdateCompactBuffer(const CompactInstance* instances, const int num)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, model_buffer);
+	glBufferData(GL_ARRAY_BUFFER, num * sizeof(CompactInstance), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, num * sizeof(CompactInstance), &instances[0]);
+}
+
+void CompactInstance::Set(glm::vec3 position, float scale, glm::vec3 eulerAngles)
+{
+	positionScale = glm::vec4(position, scale);
+	glm::quat q(eulerAngles);
+	rotation[0] = (short)glm::round(glm::clamp(q.x, -1.0f, 1.0f) * 32767.0f);
+	rotation[1] = (short)glm::round(glm::clamp(q.y, -1.0f, 1.0f) * 32767.0f);
+	rotation[2] = (short)glm::round(glm::clamp(q.z, -1.0f, 1.0f) * 32767.0f);
+	rotation[3] = (short)glm::round(glm::clamp(q.w, -1.0f, 1.0f) * 32767.0f);
+}
+
 
 void Shapes::checkErrorShader(GLuint shader) {
 	// Get log length
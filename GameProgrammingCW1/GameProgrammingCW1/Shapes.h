@@ -8,6 +8,16 @@ using namespace std;
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+// Compact per instance data, 24 bytes instead of a 64 byte model matrix.
+// The vertex shader rebuilds translate * rotate * scale from it.
+struct CompactInstance
+{
+	glm::vec4 positionScale;	// xyz position, w uniform scale
+	short rotation[4];			// unit quaternion xyzw as snorm16
+
+	void Set(glm::vec3 position, float scale, glm::vec3 eulerAngles);
+};
+
 class Shapes {
 
 public:
@@ -17,9 +27,11 @@ public:
 	void Load();
 	void LoadInstanced(glm::mat4* models, const int num);
 	void LoadParticles(glm::mat4* models, const int num);
+	void LoadCompactInstanced(const CompactInstance* instances, const int num);
 	void Draw();
 	void DrawInstanced(const int numInstances);
 	void UpdateModelBuffer(glm::mat4* models, const int num);
+	void UpdateCompactBuffer(const CompactInstance* instances, const int num);
 	void  checkErrorShader(GLuint shader);
 
 	vector<GLfloat> vertexPositions;
@@ -29,6 +41,7 @@ public:
 	GLuint			texture;
 	GLuint          vertex_buffer;
 	GLuint			model_buffer;
+	int				instanceAttributes = 4;	// per instance attribute arrays after the position
 	GLint           mv_location;
 	GLint			view_location;
 	GLint           proj_location;
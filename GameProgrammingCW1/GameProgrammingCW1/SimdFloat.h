@@ -0,0 +1,168 @@
+#ifndef SIMD_FLOAT_H
+#define SIMD_FLOAT_H
+
+// Minimal float vector types used by the data oriented kernels.
+// SimdFloat is the widest type the compiler targets (AVX2 -> 8 lanes,
+// SSE2 -> 4 lanes, otherwise 1 lane) and ScalarFloat always has one lane so the
+// same templated kernel can process the tail of an array.
+// Comparisons return a lane mask that is used with Select / Mask.
+
+#include <cmath>
+
+#if defined(__AVX2__)
+	#define SIMD_AVX2
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SIMD_SSE2
+	#include <emmintrin.h>
+#endif
+
+struct ScalarFloat
+{
+	static const int Width = 1;
+	float v;
+
+	ScalarFloat() {}
+	ScalarFloat(float value) : v(value) {}
+
+	static ScalarFloat Load(const float* p) { return ScalarFloat(*p); }
+	void Store(float* p) const { *p = v; }
+
+	friend ScalarFloat operator+(ScalarFloat a, ScalarFloat b) { return ScalarFloat(a.v + b.v); }
+	friend ScalarFloat operator-(ScalarFloat a, ScalarFloat b) { return ScalarFloat(a.v - b.v); }
+	friend ScalarFloat operator*(ScalarFloat a, ScalarFloat b) { return ScalarFloat(a.v * b.v); }
+	friend ScalarFloat operator/(ScalarFloat a, ScalarFloat b) { return ScalarFloat(a.v / b.v); }
+	ScalarFloat& operator+=(ScalarFloat b) { v += b.v; return *this; }
+
+	// mask lanes are all ones or all zeros, for one lane a bool is enough
+	friend bool operator<(ScalarFloat a, ScalarFloat b) { return a.v < b.v; }
+
+	friend ScalarFloat Min(ScalarFloat a, ScalarFloat b) { return ScalarFloat(a.v < b.v ? a.v : b.v); }
+	friend ScalarFloat Max(ScalarFloat a, ScalarFloat b) { return ScalarFloat(a.v > b.v ? a.v : b.v); }
+	friend ScalarFloat Abs(ScalarFloat a) { return ScalarFloat(std::fabs(a.v)); }
+	friend ScalarFloat Sqrt(ScalarFloat a) { return ScalarFloat(std::sqrt(a.v)); }
+	friend ScalarFloat Mask(bool mask, ScalarFloat a) { return ScalarFloat(mask ? a.v : 0.0f); }
+	friend ScalarFloat Select(bool mask, ScalarFloat a, ScalarFloat b) { return mask ? a : b; }
+	friend float Sum(ScalarFloat a) { return a.v; }
+};
+
+inline bool And(bool a, bool b) { return a && b; }
+inline bool Or(bool a, bool b) { return a || b; }
+inline bool Any(bool mask) { return mask; }
+
+#if defined(SIMD_AVX2)
+
+struct SimdMask
+{
+	__m256 m;
+	SimdMask(__m256 mask) : m(mask) {}
+};
+
+inline SimdMask And(SimdMask a, SimdMask b) { return _mm256_and_ps(a.m, b.m); }
+inline SimdMask Or(SimdMask a, SimdMask b) { return _mm256_or_ps(a.m, b.m); }
+inline bool Any(SimdMask mask) { return _mm256_movemask_ps(mask.m) != 0; }
+
+struct SimdFloat
+{
+	static const int Width = 8;
+	__m256 v;
+
+	SimdFloat() {}
+	SimdFloat(float value) : v(_mm256_set1_ps(value)) {}
+	SimdFloat(__m256 value) : v(value) {}
+
+	static SimdFloat Load(const float* p) { return SimdFloat(_mm256_loadu_ps(p)); }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+
+	friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a.v, b.v); }
+	friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a.v, b.v); }
+	friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a.v, b.v); }
+	friend SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a.v, b.v); }
+	SimdFloat& operator+=(SimdFloat b) { v = _mm256_add_ps(v, b.v); return *this; }
+
+	friend SimdMask operator<(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+
+	friend SimdFloat Min(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+	friend SimdFloat Max(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+	friend SimdFloat Abs(SimdFloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+	friend SimdFloat Sqrt(SimdFloat a) { return _mm256_sqrt_ps(a.v); }
+	friend SimdFloat Mask(SimdMask mask, SimdFloat a) { return _mm256_and_ps(mask.m, a.v); }
+	friend SimdFloat Select(SimdMask mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.m); }
+	friend float Sum(SimdFloat a)
+	{
+		__m128 s = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+		s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+		s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+		return _mm_cvtss_f32(s);
+	}
+};
+
+#elif defined(SIMD_SSE2)
+
+struct SimdMask
+{
+	__m128 m;
+	SimdMask(__m128 mask) : m(mask) {}
+};
+
+inline SimdMask And(SimdMask a, SimdMask b) { return _mm_and_ps(a.m, b.m); }
+inline SimdMask Or(SimdMask a, SimdMask b) { return _mm_or_ps(a.m, b.m); }
+inline bool Any(SimdMask mask) { return _mm_movemask_ps(mask.m) != 0; }
+
+struct SimdFloat
+{
+	static const int Width = 4;
+	__m128 v;
+
+	SimdFloat() {}
+	SimdFloat(float value) : v(_mm_set1_ps(value)) {}
+	SimdFloat(__m128 value) : v(value) {}
+
+	static SimdFloat Load(const float* p) { return SimdFloat(_mm_loadu_ps(p)); }
+	void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+	friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm_add_ps(a.v, b.v); }
+	friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a.v, b.v); }
+	friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a.v, b.v); }
+	friend SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm_div_ps(a.v, b.v); }
+	SimdFloat& operator+=(SimdFloat b) { v = _mm_add_ps(v, b.v); return *this; }
+
+	friend SimdMask operator<(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a.v, b.v); }
+
+	friend SimdFloat Min(SimdFloat a, SimdFloat b) { return _mm_min_ps(a.v, b.v); }
+	friend SimdFloat Max(SimdFloat a, SimdFloat b) { return _mm_max_ps(a.v, b.v); }
+	friend SimdFloat Abs(SimdFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+	friend SimdFloat Sqrt(SimdFloat a) { return _mm_sqrt_ps(a.v); }
+	friend SimdFloat Mask(SimdMask mask, SimdFloat a) { return _mm_and_ps(mask.m, a.v); }
+	friend SimdFloat Select(SimdMask mask, SimdFloat a, SimdFloat b) { return _mm_or_ps(_mm_and_ps(mask.m, a.v), _mm_andnot_ps(mask.m, b.v)); }
+	friend float Sum(SimdFloat a)
+	{
+		__m128 s = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+		s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+		return _mm_cvtss_f32(s);
+	}
+};
+
+#else
+
+typedef ScalarFloat SimdFloat;
+
+#endif
+
+// Runs kernel(i, lane) over [begin, end), SimdFloat wide first and ScalarFloat
+// for the remaining tail, lane is only used for its type.
+template<typename Kernel>
+inline void RunKernel(unsigned int begin, unsigned int end, Kernel kernel)
+{
+	unsigned int i = begin;
+	for (; i + SimdFloat::Width <= end; i += SimdFloat::Width)
+	{
+		kernel(i, SimdFloat());
+	}
+	for (; i < end; i++)
+	{
+		kernel(i, ScalarFloat());
+	}
+}
+
+#endif // !SIMD_FLOAT_H
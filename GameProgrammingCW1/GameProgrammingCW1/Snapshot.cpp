@@ -0,0 +1,84 @@
+#include "Snapshot.h"
+#include <algorithm>
+
+// defined here as well since std::min takes it by reference
+const unsigned int Snapshot::BLOCK_SIZE;
+
+Snapshot::Snapshot()
+{
+}
+
+Snapshot::~Snapshot()
+{
+}
+
+void Snapshot::append(const void* bytes, unsigned int size)
+{
+	const unsigned char* begin = static_cast<const unsigned char*>(bytes);
+	data.insert(data.end(), begin, begin + size);
+}
+
+// delta layout: total size, then runs of (offset, length, bytes) covering the
+// changed blocks, anything past the end of base is one run
+void Snapshot::WriteDelta(const Snapshot& base, Snapshot& delta) const
+{
+	delta.Clear();
+	unsigned int size = data.size();
+	delta.append(&size, sizeof(size));
+
+	unsigned int common = std::min(size, base.Size());
+	unsigned int offset = 0;
+	while (offset < size)
+	{
+		// skip matching blocks
+		while (offset < common)
+		{
+			unsigned int length = std::min(BLOCK_SIZE, common - offset);
+			if (std::memcmp(&data[offset], &base.data[offset], length) != 0)
+				break;
+			offset += length;
+		}
+		if (offset >= size)
+			break;
+
+		// extend the run over changed blocks
+		unsigned int end = offset;
+		while (end < size)
+		{
+			unsigned int length = std::min(BLOCK_SIZE, size - end);
+			if (end + length <= common && std::memcmp(&data[end], &base.data[end], length) == 0)
+				break;
+			end += length;
+		}
+
+		unsigned int length = end - offset;
+		delta.append(&offset, sizeof(offset));
+		delta.append(&length, sizeof(length));
+		delta.append(&data[offset], length);
+		offset = end;
+	}
+}
+
+void Snapshot::ApplyDelta(const Snapshot& base, const Snapshot& delta)
+{
+	unsigned int size;
+	std::memcpy(&size, delta.Data(), sizeof(size));
+
+	data.resize(size);
+	unsigned int common = std::min(size, base.Size());
+	if (common > 0)
+	{
+		std::memcpy(&data[0], base.Data(), common);
+	}
+
+	unsigned int position = sizeof(size);
+	while (position < delta.Size())
+	{
+		unsigned int offset, length;
+		std::memcpy(&offset, delta.Data() + position, sizeof(offset));
+		std::memcpy(&length, delta.Data() + position + sizeof(offset), sizeof(length));
+		position += sizeof(offset) + sizeof(length);
+		std::memcpy(&data[offset], delta.Data() + position, length);
+		position += length;
+	}
+}
@@ -0,0 +1,88 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <cstring>
+#include <type_traits>
+
+// Simulation state copied into one contiguous buffer.
+// Systems append their plain-data arrays with Write and get them back in the
+// same order through a SnapshotReader, every array is a single memcpy.
+// A delta against an earlier snapshot of the same layout only stores the
+// 64 byte blocks that changed.
+class Snapshot
+{
+public:
+	Snapshot();
+	~Snapshot();
+
+	void Clear() { data.clear(); }
+	unsigned int Size() const { return data.size(); }
+	const unsigned char* Data() const { return data.data(); }
+
+	template <typename T>
+	void Write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "snapshots only hold plain data");
+		append(&value, sizeof(T));
+	}
+
+	template <typename T>
+	void Write(const std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "snapshots only hold plain data");
+		unsigned int count = values.size();
+		append(&count, sizeof(count));
+		append(values.data(), count * sizeof(T));
+	}
+
+	// delta = the changes from base to this snapshot
+	void WriteDelta(const Snapshot& base, Snapshot& delta) const;
+	// this = base with the delta applied
+	void ApplyDelta(const Snapshot& base, const Snapshot& delta);
+
+private:
+	static const unsigned int BLOCK_SIZE = 64;
+
+	std::vector<unsigned char> data;
+
+	void append(const void* bytes, unsigned int size);
+
+	friend class SnapshotReader;
+};
+
+// Reads a snapshot back in the order it was written.
+class SnapshotReader
+{
+public:
+	SnapshotReader(const Snapshot& snapshot) : snapshot(snapshot) {}
+
+	template <typename T>
+	void Read(T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "snapshots only hold plain data");
+		copy(&value, sizeof(T));
+	}
+
+	template <typename T>
+	void Read(std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "snapshots only hold plain data");
+		unsigned int count;
+		copy(&count, sizeof(count));
+		values.resize(count);
+		copy(values.data(), count * sizeof(T));
+	}
+
+private:
+	const Snapshot& snapshot;
+	unsigned int offset = 0;
+
+	void copy(void* bytes, unsigned int size)
+	{
+		std::memcpy(bytes, &snapshot.data[0] + offset, size);
+		offset += size;
+	}
+};
+
+#endif // !SNAPSHOT_H
@@ -15,6 +15,7 @@
 #include <vector>
 #include <time.h>
 #include <stack>
+#include <algorithm>
 using namespace std;
 
 // Helper graphic libraries
@@ -30,7 +31,17 @@ using namespace std;
 #include "shapes.h"
 #include "Astar.h"
 #include "Body.h"
+#include "PhysicsWorld.h"
+#include "FixedTimestep.h"
+#include "ContactStream.h"
+#include "Log.h"
 #include "Player.h"
+#include "FlockManager.h"
+#include "ThreadPool.h"
+#include "AabbTree.h"
+#include "TileMap.h"
+#include "Snapshot.h"
+#include "GridRaycaster.h"
 
 // MAIN FUNCTIONS
 void startup();
@@ -49,12 +60,17 @@ void onMouseWheelCallback(GLFWwindow* window, double xoffset, double yoffset);
 bool        quit = false;
 float       deltaTime = 0.0f;    // Keep track of time per frame.
 float       lastTime = 0.0f;    // variable to keep overall time.
+FixedTimestep simulationClock(60.0f);	// physics, flocking and particles steps per second.
+int         simulationSteps = 0;	// fixed steps to run this frame.
 bool        keyStatus[1024];    // Hold key status.
 bool		mouseEnabled = true; // keep track of mouse toggle.
 
 // MAIN GRAPHICS OBJECT
 Graphics    myGraphics;   
 
+// WORKER THREADS (main thread also takes part in parallel loops)
+ThreadPool  workerThreads(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+
 // CUSTOM DEFINITIONS
 
 #pragma region CAMERA POSITIONS DEFINITIONS
@@ -113,6 +129,10 @@ std::vector<std::vector<int>> map = {
 					{1,1,1,1,1,1,1,1,1,1,1,1}
 };
 
+// walls of map for line of sight checks
+TileMap astarTiles;
+GridRaycaster astarRays;
+
 // ASTAR FUNCTIONS
 void setNewAgentTarget();
 void moveAgentToTarget();
@@ -122,7 +142,8 @@ void updateAgentPosition();
 #pragma region PLAYER DEFINITIONS
 
 Cube player;
-Body playerBody(glm::vec3(110.0f, 0.5f, 104.0f), glm::vec3(0.0f), glm::vec3(1.0f));
+PhysicsWorld playerPhysics;
+BodyHandle playerBody;
 
 std::vector<std::vector<int>> playerGrid = {
 					{1,1,1,1,1,1,1,1,1,1,1,1},
@@ -142,16 +163,27 @@ std::vector<std::vector<int>> playerGrid = {
 Cube playerGridFloor;
 glm::vec3 playerGridFloorScale(12.0f, 0.001f, 12.0f);
 
-// Grid bodies (instance rendering)
+// Grid walls (instance rendering), collision tests only the cells a body covers
 Cube playerGridObstacles;
-std::vector<Body> playerGridObstacleBodies;
+TileMap playerTiles;
 
 glm::mat4* playerGridObstaclesModels;
 
+// Broadphase for bodies off the grid, indexed by proxy id
+AabbTree playerBroadphase;
+std::vector<BodyHandle> playerCollisionBodies;
+unsigned int playerProxy;
+
+// Contacts found each step, read by the response
+ContactStream playerContacts;
+const unsigned int contactChunkSize = 64;
+
 
 // Player Functions
 void checkPlayerInputs();
-bool CheckCollision(Body& obj1, Body& obj2);
+void FindPlayerContacts(const std::vector<ProxyPair>& pairs);
+void RespondToContact(const Contact& contact);
+void pushAgainstWall(BodyHandle body);
 #pragma endregion
 
 #pragma region BOIDS DEFINITIONS
@@ -165,7 +197,8 @@ glm::vec3 boidsControllerPosition(210.0f, 1.5f, 204.0f);
 
 // Boids (instance rendering)
 Sphere boids;
-std::vector<Body> boidsBodies;
+FlockManager boidsFlocks;
+unsigned int boidsFlockId;
 glm::mat4 boidsModels[numBoids];
 
 // Boids Grid
@@ -188,16 +221,14 @@ std::vector<std::vector<int>> boidsGrid = {
 Cube boidsgridFloor;
 glm::vec3 boidsGridFloorScale(12.0f, 0.001f, 12.0f);
 
-// Grid bodies (instance rendering)
+// Grid walls (instance rendering)
 Cube boidsGridObstacles;
-std::vector<Body> boidsGridObstacleBodies;
+TileMap boidsTiles;
 
 glm::mat4* boidsGridObstaclesModels;
 
-// FUNCTIONS
-void BoidRule1();
-void BoidRule2();
-void BoidRule3();
+// Distance to the grid walls, boids avoid and collide with it
+DistanceField boidsObstacleField;
 
 #pragma endregion
 
@@ -207,6 +238,7 @@ void BoidRule3();
 struct Particle
 {
 	glm::vec3 position;
+	glm::vec3 previousPosition;
 	glm::vec3 rotation;
 	float rotation_speed;
 	glm::vec3 scale;
@@ -216,16 +248,31 @@ struct Particle
 
 const int maxParticles = 50;
 const float lifeTime = 2.0f;
+const int particleBurst = 10;	// particles spawned per EmitParticle
 Cube particle;
-std::vector<Particle> particles;
-glm::mat4 particleModels[maxParticles];
+std::vector<Particle> particles;	// pool, [0, liveParticles) alive and the rest free
+int liveParticles = 0;
+CompactInstance particleInstances[maxParticles];	// position, scale and rotation, built into a model in the shader
 
 
 void InitParticles();
 void UpdateParticles(float delta);
+void UpdateParticleModels(float alpha);
 void EmitParticle(glm::vec3 position);
 #pragma endregion
 
+#pragma region SNAPSHOT DEFINITIONS
+// F5 saves the simulation, F6 saves the changes since F5 as a delta,
+// F9 rolls back to the last save.
+Snapshot savedSimulation;
+Snapshot savedDelta;
+bool hasSavedSimulation = false;
+bool hasSavedDelta = false;
+
+void SaveSimulation(Snapshot& snapshot);
+void LoadSimulation(const Snapshot& snapshot);
+#pragma endregion
+
 
 
 // Some global variable to do the animation.
@@ -241,6 +288,9 @@ int main()
 	// Close if something went wrong...
 	if (errorGraphics) return 0;					
 
+	// Console output from a background thread, the frame never waits on it.
+	Log::StartAsync();
+
 	// Setup all necessary information for startup (aka. load texture, shaders, models, etc).
 	startup();										
 
@@ -265,6 +315,8 @@ int main()
 
 	myGraphics.endProgram();         
 
+	Log::StopAsync();
+
 
 	return 0;
 }
@@ -345,6 +397,10 @@ void startup() {
 		walls.LoadInstanced(&wallmodels[0], wallPositions.size());
 		walls.fillColor = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
 
+		astarTiles.Load(map, glm::vec3(0.0f));
+		astarRays.SetTiles(&astarTiles);
+		astarRays.SetThreadPool(&workerThreads);
+
 		// initialize agent
 		astarAgent.Load();
 		astarAgent.fillColor = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
@@ -368,27 +424,20 @@ void startup() {
 		playerGridFloor.lineColor = glm::vec4(130.0f / 255.0f, 96.0f / 255.0f, 61.0f / 255.0f, 1.0f);    // Sand again
 
 		// Walls
-		for (int i = 0; i < HEIGHT; i++)
-		{
-			for (int j = 0; j < WIDTH; j++)
-			{
-				if (playerGrid[i][j] == 1)
-				{
-					Body body(glm::vec3(j + playerSceneOffset.x, 0.5f, i + playerSceneOffset.z), glm::vec3(0.0f), glm::vec3(1.0f));
-					body.isStatic = true;
-					playerGridObstacleBodies.push_back(body);
-				}
-			}
-		}
-
-		playerGridObstaclesModels = new glm::mat4[playerGridObstacleBodies.size()];
-		for (int i = 0; i < playerGridObstacleBodies.size(); i++)
-		{
-			playerGridObstaclesModels[i] = glm::translate(playerGridObstacleBodies[i].position) *
-				glm::scale(playerGridObstacleBodies[i].scale) *
-				glm::mat4(1.0f);
-		}
-		playerGridObstacles.LoadInstanced(&playerGridObstaclesModels[0], playerGridObstacleBodies.size());
+		playerTiles.Load(playerGrid, playerSceneOffset);
+
+		playerGridObstaclesModels = new glm::mat4[playerTiles.WallCount()];
+		int playerWall = 0;
+		playerTiles.ForEachWall([&](glm::vec3 position) {
+			playerGridObstaclesModels[playerWall++] = glm::translate(position) * glm::mat4(1.0f);
+		});
+		playerGridObstacles.LoadInstanced(&playerGridObstaclesModels[0], playerTiles.WallCount());
+
+		// Broadphase
+		playerPhysics.SetStaticGeometry(&playerTiles);
+		playerBody = playerPhysics.Add(Body(glm::vec3(110.0f, 0.5f, 104.0f), glm::vec3(0.0f), glm::vec3(1.0f)));
+		playerProxy = playerBroadphase.Add(playerBody.Box(), false);
+		playerCollisionBodies.push_back(playerBody);
 		
 
 		// Player
@@ -407,27 +456,14 @@ void startup() {
 		boidsgridFloor.lineColor = glm::vec4(130.0f / 255.0f, 96.0f / 255.0f, 61.0f / 255.0f, 1.0f);    // Sand again
 
 		// Walls
-		for (int i = 0; i < HEIGHT; i++)
-		{
-			for (int j = 0; j < WIDTH; j++)
-			{
-				if (boidsGrid[i][j] == 1)
-				{
-					Body body(glm::vec3(j + boidsSceneOffset.x, 0.5f, i + boidsSceneOffset.z), glm::vec3(0.0f), glm::vec3(1.0f));
-					body.isStatic = true;
-					boidsGridObstacleBodies.push_back(body);
-				}
-			}
-		}
+		boidsTiles.Load(boidsGrid, boidsSceneOffset);
 
-		boidsGridObstaclesModels = new glm::mat4[playerGridObstacleBodies.size()];
-		for (int i = 0; i < boidsGridObstacleBodies.size(); i++)
-		{
-			boidsGridObstaclesModels[i] = glm::translate(boidsGridObstacleBodies[i].position) *
-				glm::scale(playerGridObstacleBodies[i].scale) *
-				glm::mat4(1.0f);
-		}
-		boidsGridObstacles.LoadInstanced(&boidsGridObstaclesModels[0], numBoids);
+		boidsGridObstaclesModels = new glm::mat4[boidsTiles.WallCount()];
+		int boidsWall = 0;
+		boidsTiles.ForEachWall([&](glm::vec3 position) {
+			boidsGridObstaclesModels[boidsWall++] = glm::translate(position) * glm::mat4(1.0f);
+		});
+		boidsGridObstacles.LoadInstanced(&boidsGridObstaclesModels[0], boidsTiles.WallCount());
 
 		// Controller
 		boidsController.Load();
@@ -436,17 +472,20 @@ void startup() {
 
 		// Boids
 
+		boidsFlocks.SetThreadPool(&workerThreads);
+		boidsFlockId = boidsFlocks.AddFlock();
+		Flock& boidsFlock = boidsFlocks.GetFlock(boidsFlockId);
+		boidsFlock.topSpeed = 0.2f;
+		boidsObstacleField.Build(boidsGrid, boidsSceneOffset, 4, 2.0f);
+		boidsFlock.SetObstacleField(&boidsObstacleField);
 		for (int i = 0; i < numBoids; i++)
 		{
-			Body body(glm::vec3(boidsSceneOffset.x + rand() % 10 + 1, 0.5f, boidsSceneOffset.z + rand() % 10 + 1), glm::vec3(0.0f), glm::vec3(1.0f));
-			body.debugSpeed = 1;
-			body.isBoid = true;
-			body.topSpeed = 0.2f;
-			boidsBodies.push_back(body);
+			glm::vec3 position(boidsSceneOffset.x + rand() % 10 + 1, 0.5f, boidsSceneOffset.z + rand() % 10 + 1);
+			boidsFlock.Add(position);
 
 			//init model matrix
-			boidsModels[i] = glm::translate(body.position) *
-				glm::scale(body.scale) *
+			boidsModels[i] = glm::translate(position) *
+				glm::scale(boidsFlock.boidScale) *
 				glm::mat4(1.0f);
 		}
 
@@ -460,7 +499,7 @@ void startup() {
 		InitParticles();
 
 		particle.fillColor = glm::vec4(0.1f, 0.1f, 0.1f, 0.7f);
-		particle.LoadInstanced(&particleModels[0], maxParticles);
+		particle.LoadCompactInstanced(&particleInstances[0], maxParticles);
 
 	#pragma endregion
 
@@ -544,6 +583,8 @@ void updateSceneElements() {
 		deltaTime = currentTime - lastTime;
 		// Save for next frame calculations.
 		lastTime = currentTime;
+		// Whole simulation steps this frame, the rest carries over
+		simulationSteps = simulationClock.Advance(deltaTime);
 	#pragma endregion
 
 	// Custom Updates
@@ -598,17 +639,31 @@ void updateSceneElements() {
 				playerGridObstacles.proj_matrix = myGraphics.proj_matrix;
 
 				// PLAYER
-				//Check collision
-				for (int i = 0; i < playerGridObstacleBodies.size(); i++) {
-					CheckCollision(playerBody, playerGridObstacleBodies[i]);
-				}
+				for (int step = 0; step < simulationSteps; step++)
+				{
+					// sleeping bodies stay where they are in the broadphase
+					for (unsigned int proxy = 0; proxy < playerCollisionBodies.size(); proxy++) {
+						BodyHandle body = playerCollisionBodies[proxy];
+						playerBroadphase.SetSleeping(proxy, body.IsSleeping());
+						if (!body.IsStatic() && !body.IsSleeping()) {
+							playerBroadphase.Move(proxy, body.Box(), body.Velocity() * simulationClock.Step());
+							body.SetColliding(false);
+						}
+					}
 
-				// Update physics
-				playerBody.Update(deltaTime);
+					//Check collision, only the pairs the broadphase finds and the walls under each body
+					FindPlayerContacts(playerBroadphase.FindPairs());
+					for (const Contact& contact : playerContacts.Events()) {
+						RespondToContact(contact);
+					}
 
-				// Update model-view-projection
+					// Update physics
+					playerPhysics.Step(simulationClock.Step());
+				}
+
+				// Update model-view-projection, between the last two steps
 				player.mv_matrix = myGraphics.viewMatrix *
-					glm::translate(playerBody.position) *
+					glm::translate(playerBody.InterpolatedPosition(simulationClock.Alpha())) *
 					glm::mat4(1.0f);
 				player.proj_matrix = myGraphics.proj_matrix;
 
@@ -637,21 +692,12 @@ void updateSceneElements() {
 				boidsController.proj_matrix = myGraphics.proj_matrix;
 
 				// boids updates
-				BoidRule1();
-				BoidRule2();
-				BoidRule3();
-
-				for (int i = 0; i < boidsBodies.size(); i++)
+				// rules, integration and obstacle collision
+				boidsFlocks.SetTarget(boidsFlockId, boidsControllerPosition);
+				boidsFlocks.BeginFrame();
+				for (int step = 0; step < simulationSteps; step++)
 				{
-					boidsBodies[i].velocity += boidsBodies[i].boidVelocity;
-					boidsBodies[i].Update(deltaTime);
-					boidsBodies[i].boidVelocity = glm::vec3(0, 0, 0);
-				}
-
-				for (int i = 0; i < boidsBodies.size(); i++) {
-					for (int j = 0; j < boidsGridObstacleBodies.size(); j++) {
-						CheckCollision(boidsBodies[i], boidsGridObstacleBodies[j]);
-					}
+					boidsFlocks.Update(simulationClock.Step(), myGraphics.cameraPosition, myGraphics.proj_matrix * myGraphics.viewMatrix);
 				}
 
 				// boids view-projection
@@ -662,7 +708,7 @@ void updateSceneElements() {
 				// boids model
 				for (int i = 0; i < numBoids; i++)
 				{
-					boidsModels[i] = glm::translate(boidsBodies[i].position) *
+					boidsModels[i] = glm::translate(boidsFlocks.Position(boidsFlockId, i, simulationClock.Alpha())) *
 						glm::mat4(1.0f);
 				}
 				
@@ -672,7 +718,11 @@ void updateSceneElements() {
 
 	#pragma region PARTICLES UPDATE
 		//ps.Update(deltaTime);
-		UpdateParticles(deltaTime);
+		for (int step = 0; step < simulationSteps; step++)
+		{
+			UpdateParticles(simulationClock.Step());
+		}
+		UpdateParticleModels(simulationClock.Alpha());
 		particle.view_matrix = myGraphics.viewMatrix;
 		particle.proj_matrix = myGraphics.proj_matrix;
 	#pragma endregion
@@ -705,7 +755,7 @@ void renderScene() {
 
 		// GRID
 		playerGridFloor.Draw();
-		playerGridObstacles.DrawInstanced(playerGridObstacleBodies.size());
+		playerGridObstacles.DrawInstanced(playerTiles.WallCount());
 
 		// PLAYER
 		player.Draw();
@@ -716,7 +766,7 @@ void renderScene() {
 
 		// GRID
 		boidsgridFloor.Draw();
-		boidsGridObstacles.DrawInstanced(boidsGridObstacleBodies.size());
+		boidsGridObstacles.DrawInstanced(boidsTiles.WallCount());
 
 		// CONTROLLER
 		boidsController.Draw();
@@ -727,7 +777,7 @@ void renderScene() {
 
 #pragma region PARTICLE RENDER
 		//ps.Render(myGraphics.viewMatrix, myGraphics.proj_matrix);
-		particle.DrawInstanced(maxParticles);
+		particle.DrawInstanced(liveParticles);
 #pragma endregion
 
 
@@ -778,127 +828,113 @@ void renderScene() {
 
 #pragma region COLLISION FUNCTIONS
 
-	bool CheckCollision(Body& obj1, Body& obj2)
+	// detection only reads bodies, each chunk writes its own contact buffer
+	void FindPlayerContacts(const std::vector<ProxyPair>& pairs)
 	{
-		if (obj1.left < obj2.right && obj1.right > obj2.left && obj1.up > obj2.down&& obj1.down < obj2.up)
+		unsigned int pairChunks = (pairs.size() + contactChunkSize - 1) / contactChunkSize;
+		unsigned int bodyChunks = (playerCollisionBodies.size() + contactChunkSize - 1) / contactChunkSize;
+		playerContacts.BeginTick(pairChunks + bodyChunks);
+
+		workerThreads.ParallelFor(pairs.size(), contactChunkSize, [&](unsigned int begin, unsigned int end)
 		{
-			obj1.isColliding = true;
-			if (obj1.isBoid && obj2.isBoid)
+			for (unsigned int k = begin; k < end; k++)
 			{
-				obj2.isColliding = true;
-				obj1.addedForce = (obj1.velocity * glm::vec3(1.5f, 1.5f, 1.5f));// *glm::vec3(-1, -1, -1);
-				obj2.addedForce = (obj1.velocity * glm::vec3(-1, -1, -1));
-				if (obj1.position.y < 1)
+				float normalX, normalZ, depth;
+				const ProxyPair& pair = pairs[k];
+				if (playerCollisionBodies[pair.a].Box().Penetration(playerCollisionBodies[pair.b].Box(), normalX, normalZ, depth))
 				{
-					obj1.addedForce.y = 10;
+					playerContacts.Add(begin / contactChunkSize, pair.a, pair.b, normalX, normalZ, depth);
 				}
-				return true;
-			}
-			else if (obj1.isBoid && !obj2.isBoid)
-			{
-				obj1.addedForce = (obj1.velocity * glm::vec3(1.5f, 1.5f, 1.5f));// *glm::vec3(-1, -1, -1);
-				return true;
 			}
+		});
 
-			obj1.isColliding = true;
-			if (obj1.direction == Direction::Left && obj2.direction == Direction::Idle)
+		workerThreads.ParallelFor(playerCollisionBodies.size(), contactChunkSize, [&](unsigned int begin, unsigned int end)
+		{
+			unsigned int chunk = pairChunks + begin / contactChunkSize;
+			for (unsigned int proxy = begin; proxy < end; proxy++)
 			{
-				obj1.addedForce = glm::vec3(-5, 0, 0);
-				printf("COLLIDING LEFT\n");
+				BodyHandle body = playerCollisionBodies[proxy];
+				if (body.IsStatic() || body.IsSleeping())
+					continue;
 
+				Aabb box = body.Box();
+				playerTiles.ForEachWall(box, [&](const Aabb& wall, unsigned int cell)
+				{
+					float normalX, normalZ, depth;
+					box.Penetration(wall, normalX, normalZ, depth);
+					playerContacts.Add(chunk, proxy, Contact::WALL | cell, normalX, normalZ, depth);
+				});
 			}
-			else if (obj1.direction == Direction::Right && obj2.direction == Direction::Idle)
-			{
-				obj1.addedForce = glm::vec3(5, 0, 0);
-				printf("COLLIDING RIGHT\n");
+		});
 
-			}
-			else if (obj1.direction == Direction::Up && obj2.direction ==Direction::Idle)
+		playerContacts.EndTick();
+	}
+
+	// same responses as the old CheckCollision, bodies touching share an island
+	void RespondToContact(const Contact& contact)
+	{
+		if (contact.state == ContactState::End)
+			return;
+
+		BodyHandle obj1 = playerCollisionBodies[contact.a];
+		obj1.SetColliding(true);
+		if (contact.IsWall())
+		{
+			if (obj1.IsBoid())
 			{
-				obj1.addedForce = glm::vec3(0, 0, -5);
-				printf("COLLIDING UP\n");
+				obj1.SetAddedForce(obj1.Velocity() * glm::vec3(1.5f, 1.5f, 1.5f));
+				return;
 			}
-			else if (obj1.direction == Direction::Down && obj2.direction == Direction::Idle)
+			pushAgainstWall(obj1);
+			return;
+		}
+
+		BodyHandle obj2 = playerCollisionBodies[contact.b];
+		playerPhysics.AddContact(obj1.Index(), obj2.Index());
+		if (obj1.IsBoid() && obj2.IsBoid())
+		{
+			obj2.SetColliding(true);
+			glm::vec3 force = (obj1.Velocity() * glm::vec3(1.5f, 1.5f, 1.5f));// *glm::vec3(-1, -1, -1);
+			obj2.SetAddedForce(obj1.Velocity() * glm::vec3(-1, -1, -1));
+			if (obj1.Position().y < 1)
 			{
-				obj1.addedForce = glm::vec3(0, 0, 5);
-				printf("COLLIDING DOWN \n");
+				force.y = 10;
 			}
-			return true;
+			obj1.SetAddedForce(force);
 		}
-		obj1.isColliding = false;
-		obj2.isColliding = false;
-		return false;
-	}
-
-#pragma endregion
-
-#pragma region BOIDS FUNCTIONS
-
-	glm::vec3 GetBoidsCenter()
-	{
-		glm::vec3 temp = glm::vec3(0, 0, 0);
-		for (int i = 0; i < boidsBodies.size(); i++)
+		else if (obj1.IsBoid() && !obj2.IsBoid())
 		{
-			temp += boidsBodies[i].position;
+			obj1.SetAddedForce(obj1.Velocity() * glm::vec3(1.5f, 1.5f, 1.5f));// *glm::vec3(-1, -1, -1);
 		}
-
-		glm::vec3 temp2 = glm::vec3(temp.x / boidsBodies.size(), temp.y / boidsBodies.size(), temp.z / boidsBodies.size());
-		return temp2;
-	}
-
-	void BoidRule1()
-	{
-		for (int i = 0; i < boidsBodies.size(); i++)
+		else if (obj2.MoveDirection() == Direction::Idle)
 		{
-			boidsBodies[i].boidVelocity += (GetBoidsCenter() - boidsBodies[i].position) / glm::vec3(100, 100, 100);
-			boidsBodies[i].boidVelocity += (boidsControllerPosition - boidsBodies[i].position) / glm::vec3(8, 8, 8);
+			pushAgainstWall(obj1);
 		}
-
 	}
 
-	void BoidRule2()
+	void pushAgainstWall(BodyHandle body)
 	{
-		for (int i = 0; i < boidsBodies.size(); i++)
+		if (body.MoveDirection() == Direction::Left)
 		{
-			if (boidsBodies[i].position.y < 1)
-			{
-				boidsBodies[i].boidVelocity += 1;
-			}
-
-			for (int j = 0; j < boidsBodies.size(); j++)
-			{
-				if (i != j)
-				{
-					if (glm::distance(boidsBodies[i].position, boidsBodies[j].position) < 1)
-					{
-						boidsBodies[i].boidVelocity += boidsBodies[i].position - boidsBodies[j].position;
-					}
-				}
-			}
-
-			for (int j = 0; j < boidsGridObstacleBodies.size(); j++)
-			{
-				if (glm::distance(boidsBodies[i].position, boidsGridObstacleBodies[j].position) < 1.2f)
-				{
-					boidsBodies[i].boidVelocity += boidsBodies[i].position - boidsGridObstacleBodies[j].position;
-				}
-			}
+			body.SetAddedForce(glm::vec3(-5, 0, 0));
+			LOG_DEBUG(LogCategory::Collision, "COLLIDING LEFT");
 
 		}
-	}
-
-	void BoidRule3()
-	{
-		glm::vec3 tempVel = glm::vec3(0, 0, 0);
-		for (int i = 0; i < boidsBodies.size(); i++)
+		else if (body.MoveDirection() == Direction::Right)
 		{
-			for (int j = 0; j < boidsBodies.size(); j++)
-			{
-				tempVel += boidsBodies[j].velocity;
-			}
+			body.SetAddedForce(glm::vec3(5, 0, 0));
+			LOG_DEBUG(LogCategory::Collision, "COLLIDING RIGHT");
 
-			tempVel = glm::vec3(tempVel.x / boidsBodies.size(), tempVel.y / boidsBodies.size(), tempVel.z / boidsBodies.size());
-			boidsBodies[i].boidVelocity += tempVel / glm::vec3(8, 8, 8);
+		}
+		else if (body.MoveDirection() == Direction::Up)
+		{
+			body.SetAddedForce(glm::vec3(0, 0, -5));
+			LOG_DEBUG(LogCategory::Collision, "COLLIDING UP");
+		}
+		else if (body.MoveDirection() == Direction::Down)
+		{
+			body.SetAddedForce(glm::vec3(0, 0, 5));
+			LOG_DEBUG(LogCategory::Collision, "COLLIDING DOWN");
 		}
 	}
 
@@ -931,41 +967,112 @@ void renderScene() {
 
 			p.life = 0.0f;
 
+			p.position = glm::vec3(0.0f);
+			p.previousPosition = p.position;
+
 			particles.push_back(p);
 		}
 	}
 	void UpdateParticles(float delta)
 	{
-		
-		for (int i = 0; i < maxParticles; i++)
+		int i = 0;
+		while (i < liveParticles)
 		{
+			// dead particles are swapped behind the last live one
+			particles[i].life += delta;
+			if (particles[i].life >= lifeTime)
+			{
+				std::swap(particles[i], particles[--liveParticles]);
+				continue;
+			}
+
 			// update position
+			particles[i].previousPosition = particles[i].position;
 			particles[i].position += particles[i].velocity * delta;
 			particles[i].rotation.x += particles[i].rotation_speed;
 			particles[i].rotation.y += particles[i].rotation_speed;
 			particles[i].rotation.z += particles[i].rotation_speed;
-			
-			// update models
-			particleModels[i] = glm::translate(particles[i].position) *
-				glm::rotate(particles[i].rotation.x, glm::vec3(1.0f, 0.0f, 0.0f)) *
-				glm::rotate(particles[i].rotation.x, glm::vec3(1.0f, 0.0f, 0.0f)) *
-				glm::rotate(particles[i].rotation.x, glm::vec3(1.0f, 0.0f, 0.0f)) *
-				glm::scale(particles[i].scale) *
-				glm::mat4(1.0f);
+			i++;
+		}
+	}
+	void UpdateParticleModels(float alpha)
+	{
+		for (int i = 0; i < liveParticles; i++)
+		{
+			// between the last two steps
+			glm::vec3 position = glm::mix(particles[i].previousPosition, particles[i].position, alpha);
+			particleInstances[i].Set(position, particles[i].scale.x, particles[i].rotation);
 		}
-		particle.UpdateModelBuffer(&particleModels[0], maxParticles);
+		particle.UpdateCompactBuffer(&particleInstances[0], liveParticles);
 	}
 	void EmitParticle(glm::vec3 position)
 	{
-		for (int i = 0; i < maxParticles; i++)
+		// take a burst from the free end of the pool, keeps its velocity and spin
+		for (int spawned = 0; spawned < particleBurst && liveParticles < maxParticles; spawned++)
 		{
-			particles[i].life = 0.0f;
-			particles[i].position = position;
+			Particle& p = particles[liveParticles++];
+			p.life = 0.0f;
+			p.position = position;
+			p.previousPosition = position;
 		}
 	}
 #pragma endregion
 
 
+#pragma region SNAPSHOT FUNCTIONS
+
+	void SaveSimulation(Snapshot& snapshot)
+	{
+		snapshot.Clear();
+		playerPhysics.Save(snapshot);
+		boidsFlocks.Save(snapshot);
+		snapshot.Write(boidsControllerPosition);
+		snapshot.Write(particles);
+		snapshot.Write(liveParticles);
+
+		// agent path, top of the stack last
+		std::stack<glm::vec3> path = aStarPath;
+		std::vector<glm::vec3> pathPoints;
+		while (!path.empty()) {
+			pathPoints.push_back(path.top());
+			path.pop();
+		}
+		std::reverse(pathPoints.begin(), pathPoints.end());
+		snapshot.Write(pathPoints);
+		snapshot.Write(agentPosition);
+		snapshot.Write(agentTarget);
+		snapshot.Write(agentDirection);
+		snapshot.Write(goalArrowPosition);
+	}
+
+	void LoadSimulation(const Snapshot& snapshot)
+	{
+		SnapshotReader reader(snapshot);
+		playerPhysics.Load(reader);
+		boidsFlocks.Load(reader);
+		reader.Read(boidsControllerPosition);
+		reader.Read(particles);
+		reader.Read(liveParticles);
+
+		std::vector<glm::vec3> pathPoints;
+		reader.Read(pathPoints);
+		aStarPath = std::stack<glm::vec3>();
+		for (const glm::vec3& point : pathPoints) {
+			aStarPath.push(point);
+		}
+		reader.Read(agentPosition);
+		reader.Read(agentTarget);
+		reader.Read(agentDirection);
+		reader.Read(goalArrowPosition);
+
+		// sleeping bodies are not moved by the update, put every proxy back
+		for (unsigned int proxy = 0; proxy < playerCollisionBodies.size(); proxy++) {
+			playerBroadphase.Move(proxy, playerCollisionBodies[proxy].Box(), glm::vec3(0.0f));
+		}
+	}
+
+#pragma endregion
+
 #pragma region INPUT FUNCTIONS
 
 	void checkAstarInput()
@@ -996,37 +1103,57 @@ void renderScene() {
 				std::cout << "goal position" << glm::to_string(goalArrowPosition) << std::endl;
 				aStarPath = Astar::getInstance()->path(map, agentPosition, goalArrowPosition);
 			}
+
+			if (keyStatus[GLFW_KEY_L])
+			{
+				int cell;
+				float distance;
+				glm::vec3 normal;
+				glm::vec3 toGoal = goalArrowPosition - agentPosition;
+				if (astarRays.Cast(agentPosition, toGoal, glm::length(toGoal), cell, distance, normal))
+				{
+					std::cout << "goal hidden by wall " << cell % WIDTH << "," << cell / WIDTH << " at " << distance << std::endl;
+				}
+				else
+				{
+					std::cout << "goal in sight" << std::endl;
+				}
+			}
 		}
 	}
 
 	void checkPlayerInputs()
 	{
+		glm::vec3 velocity = playerBody.Velocity();
+		glm::vec3 acceleration = playerBody.Acceleration();
 		if (keyStatus[GLFW_KEY_UP])
 		{
-			playerBody.velocity.x = 0.0f;
-			if (playerBody.velocity.z < 0) playerBody.velocity.z = 0.0f;
-			playerBody.acceleration.z = 0.1f;
+			velocity.x = 0.0f;
+			if (velocity.z < 0) velocity.z = 0.0f;
+			acceleration.z = 0.1f;
 		}
 		else if (keyStatus[GLFW_KEY_DOWN]) {
-			playerBody.velocity.x = 0.0f;
-			if (playerBody.velocity.z > 0) playerBody.velocity.z = 0.0f;
-			playerBody.acceleration.z = -0.1f;
+			velocity.x = 0.0f;
+			if (velocity.z > 0) velocity.z = 0.0f;
+			acceleration.z = -0.1f;
 		}
 		else if (keyStatus[GLFW_KEY_RIGHT]) {
-			playerBody.velocity.z = 0.0f;
-			if (playerBody.velocity.x > 0) playerBody.velocity.x = 0.0f;
-			playerBody.acceleration.x = -0.1f;
+			velocity.z = 0.0f;
+			if (velocity.x > 0) velocity.x = 0.0f;
+			acceleration.x = -0.1f;
 		}
 		else if (keyStatus[GLFW_KEY_LEFT]) {
-			playerBody.velocity.z = 0.0f;
-			if (playerBody.velocity.x < 0) playerBody.velocity.x = 0.0f;
-			playerBody.acceleration.x = 0.1f;
+			velocity.z = 0.0f;
+			if (velocity.x < 0) velocity.x = 0.0f;
+			acceleration.x = 0.1f;
 		}
 		else {
-			playerBody.velocity = glm::vec3(0.0f, 0.0f, 0.0f);
-			playerBody.acceleration.x = 0.0f;
-			playerBody.acceleration.z = 0.0f;
+			velocity = glm::vec3(0.0f, 0.0f, 0.0f);
+			acceleration.x = 0.0f;
+			acceleration.z = 0.0f;
 		}
+		playerBody.SetVelocity(velocity);
+		playerBody.SetAcceleration(acceleration);
 	}
 
 	void checkBoidInputs()
@@ -1087,6 +1214,37 @@ void onKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mo
 			nextScenePressed = false;
 		}
 
+		if (action == GLFW_PRESS && key == GLFW_KEY_F5)
+		{
+			SaveSimulation(savedSimulation);
+			hasSavedSimulation = true;
+			hasSavedDelta = false;
+			std::cout << "SAVED simulation: " << savedSimulation.Size() << " bytes" << std::endl;
+		}
+
+		if (action == GLFW_PRESS && key == GLFW_KEY_F6 && hasSavedSimulation)
+		{
+			Snapshot current;
+			SaveSimulation(current);
+			current.WriteDelta(savedSimulation, savedDelta);
+			hasSavedDelta = true;
+			std::cout << "SAVED delta: " << savedDelta.Size() << " bytes" << std::endl;
+		}
+
+		if (action == GLFW_PRESS && key == GLFW_KEY_F9 && hasSavedSimulation)
+		{
+			if (hasSavedDelta)
+			{
+				Snapshot current;
+				current.ApplyDelta(savedSimulation, savedDelta);
+				LoadSimulation(current);
+			}
+			else
+			{
+				LoadSimulation(savedSimulation);
+			}
+		}
+
 		if (keyStatus[GLFW_KEY_C])
 		{
 			std::cout << "CAM position: " << glm::to_string(myGraphics.cameraPosition) << std::endl;
@@ -0,0 +1,65 @@
+#include "SpatialGrid.h"
+#include <cmath>
+
+SpatialGrid::SpatialGrid(float cellSize)
+{
+	this->cellSize = cellSize;
+	this->invCellSize = 1.0f / cellSize;
+}
+
+SpatialGrid::~SpatialGrid()
+{
+}
+
+void SpatialGrid::Build(const float* x, const float* y, const float* z, unsigned int count)
+{
+	this->count = count;
+
+	// table twice the number of points (power of two) keeps buckets short
+	unsigned int tableSize = 64;
+	while (tableSize < count * 2)
+	{
+		tableSize <<= 1;
+	}
+	tableMask = tableSize - 1;
+
+	cellStart.assign(tableSize + 1, 0);
+	entries.resize(count);
+	pointCell.resize(count);
+
+	// count points per cell
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int cell = hashCell(cellCoord(x[i]), cellCoord(y[i]), cellCoord(z[i]));
+		pointCell[i] = cell;
+		cellStart[cell + 1]++;
+	}
+
+	// prefix sum, cellStart[c] is the first entry of cell c
+	for (unsigned int c = 0; c < tableSize; c++)
+	{
+		cellStart[c + 1] += cellStart[c];
+	}
+
+	// scatter, cellStart[c] is used as write cursor and restored afterwards
+	for (unsigned int i = 0; i < count; i++)
+	{
+		entries[cellStart[pointCell[i]]++] = i;
+	}
+	for (unsigned int c = tableSize; c > 0; c--)
+	{
+		cellStart[c] = cellStart[c - 1];
+	}
+	cellStart[0] = 0;
+}
+
+int SpatialGrid::cellCoord(float value) const
+{
+	return (int)std::floor(value * invCellSize);
+}
+
+unsigned int SpatialGrid::hashCell(int cx, int cy, int cz) const
+{
+	unsigned int h = ((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u) ^ ((unsigned int)cz * 83492791u);
+	return h & tableMask;
+}
@@ -0,0 +1,101 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Uniform cell grid over a set of points, rebuilt from scratch every tick.
+// Cells are hashed into a fixed size table and the points are bucketed with a
+// counting sort, so building is O(n) and a radius query only visits the 27 cells
+// around the query point instead of every point.
+class SpatialGrid
+{
+public:
+	SpatialGrid(float cellSize);
+	~SpatialGrid();
+
+	void Build(const float* x, const float* y, const float* z, unsigned int count);
+
+	// calls visit(index) for every point stored in the cells around position,
+	// the caller still has to do the exact distance test
+	template<typename Visitor>
+	void ForEachNeighbour(glm::vec3 position, Visitor visit) const;
+
+	// calls visit(begin, end) for every non empty range of Entries() around position
+	template<typename Visitor>
+	void ForEachNeighbourRange(glm::vec3 position, Visitor visit) const;
+
+	// point indices sorted by cell
+	const std::vector<unsigned int>& Entries() const { return entries; }
+
+	float CellSize() const { return cellSize; }
+	unsigned int Size() const { return count; }
+
+private:
+	float cellSize;
+	float invCellSize;
+	unsigned int count = 0;
+	unsigned int tableMask = 0;
+
+	std::vector<unsigned int> cellStart;	// tableSize + 1 offsets into entries
+	std::vector<unsigned int> entries;		// point indices sorted by cell
+	std::vector<unsigned int> pointCell;	// cell of each point, scratch for the sort
+
+	int cellCoord(float value) const;
+	unsigned int hashCell(int cx, int cy, int cz) const;
+};
+
+template<typename Visitor>
+void SpatialGrid::ForEachNeighbour(glm::vec3 position, Visitor visit) const
+{
+	ForEachNeighbourRange(position, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			visit(entries[i]);
+		}
+	});
+}
+
+template<typename Visitor>
+void SpatialGrid::ForEachNeighbourRange(glm::vec3 position, Visitor visit) const
+{
+	if (count == 0)
+		return;
+
+	int cx = cellCoord(position.x);
+	int cy = cellCoord(position.y);
+	int cz = cellCoord(position.z);
+
+	// different cells can share a bucket, skip buckets already visited
+	unsigned int visited[27];
+	unsigned int visitedCount = 0;
+
+	for (int dx = -1; dx <= 1; dx++)
+	{
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				unsigned int cell = hashCell(cx + dx, cy + dy, cz + dz);
+
+				bool seen = false;
+				for (unsigned int i = 0; i < visitedCount && !seen; i++)
+				{
+					seen = visited[i] == cell;
+				}
+				if (seen)
+					continue;
+				visited[visitedCount++] = cell;
+
+				if (cellStart[cell] != cellStart[cell + 1])
+				{
+					visit(cellStart[cell], cellStart[cell + 1]);
+				}
+			}
+		}
+	}
+}
+
+#endif // !SPATIAL_GRID_H
@@ -0,0 +1,95 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int workerCount) : nextChunk(0), doneChunks(0)
+{
+	for (unsigned int i = 0; i < workerCount; i++)
+	{
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(unsigned int count, unsigned int chunkSize, const std::function<void(unsigned int, unsigned int)>& job)
+{
+	if (count == 0)
+		return;
+
+	unsigned int chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	// nothing to share, skip waking the workers
+	if (workers.empty() || chunkCount == 1)
+	{
+		for (unsigned int begin = 0; begin < count; begin += chunkSize)
+		{
+			job(begin, begin + chunkSize < count ? begin + chunkSize : count);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->job = &job;
+		this->count = count;
+		this->chunkSize = chunkSize;
+		this->chunkCount = chunkCount;
+		nextChunk = 0;
+		doneChunks = 0;
+		generation++;
+	}
+	wake.notify_all();
+
+	runChunks();
+
+	// workers still inside runChunks could otherwise pick chunks of the next job
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this]() { return doneChunks == this->chunkCount && activeWorkers == 0; });
+	this->job = nullptr;
+}
+
+void ThreadPool::workerLoop()
+{
+	unsigned int seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return quit || (generation != seenGeneration && job != nullptr); });
+			if (quit)
+				return;
+			seenGeneration = generation;
+			activeWorkers++;
+		}
+
+		runChunks();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeWorkers--;
+		}
+		finished.notify_all();
+	}
+}
+
+void ThreadPool::runChunks()
+{
+	unsigned int chunk;
+	while ((chunk = nextChunk.fetch_add(1)) < chunkCount)
+	{
+		unsigned int begin = chunk * chunkSize;
+		unsigned int end = begin + chunkSize < count ? begin + chunkSize : count;
+		(*job)(begin, end);
+		doneChunks.fetch_add(1);
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Persistent worker threads for data parallel loops.
+// ParallelFor splits [0, count) into fixed size chunks, the calling thread works
+// on chunks too and the call returns once every chunk is done. Chunk boundaries
+// only depend on chunkSize, never on the number of threads.
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int workerCount);
+	~ThreadPool();
+
+	void ParallelFor(unsigned int count, unsigned int chunkSize, const std::function<void(unsigned int, unsigned int)>& job);
+
+	// workers + calling thread
+	unsigned int ThreadCount() const { return workers.size() + 1; }
+
+private:
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	// current job, written under the mutex
+	const std::function<void(unsigned int, unsigned int)>* job = nullptr;
+	unsigned int count = 0;
+	unsigned int chunkSize = 0;
+	unsigned int chunkCount = 0;
+	unsigned int generation = 0;
+	unsigned int activeWorkers = 0;
+	bool quit = false;
+
+	std::atomic<unsigned int> nextChunk;
+	std::atomic<unsigned int> doneChunks;
+
+	void workerLoop();
+	void runChunks();
+};
+
+#endif // !THREAD_POOL_H
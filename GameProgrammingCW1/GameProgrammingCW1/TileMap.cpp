@@ -0,0 +1,81 @@
+#include "TileMap.h"
+
+TileMap::TileMap()
+{
+}
+
+TileMap::~TileMap()
+{
+}
+
+void TileMap::Load(const std::vector<std::vector<int>>& grid, glm::vec3 origin)
+{
+	this->origin = origin;
+	rows = grid.size();
+	columns = rows > 0 ? grid[0].size() : 0;
+
+	cells.assign(rows * columns, 0);
+	wallCount = 0;
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < columns; j++)
+		{
+			if (grid[i][j] == 1)
+			{
+				cells[i * columns + j] = 1;
+				wallCount++;
+			}
+		}
+	}
+}
+
+bool TileMap::IsWall(int row, int column) const
+{
+	if (row < 0 || row >= rows || column < 0 || column >= columns)
+		return false;
+	return cells[row * columns + column] != 0;
+}
+
+glm::vec3 TileMap::CellPosition(int row, int column) const
+{
+	return glm::vec3(origin.x + column, 0.5f, origin.z + row);
+}
+
+Aabb TileMap::CellBox(int row, int column) const
+{
+	float x = origin.x + column;
+	float z = origin.z + row;
+	return Aabb(x - 0.5f, x + 0.5f, z - 0.5f, z + 0.5f);
+}
+
+bool TileMap::Sweep(const Aabb& box, float dx, float dz, float& time, float& normalX, float& normalZ) const
+{
+	Aabb swept(std::min(box.left, box.left + dx), std::max(box.right, box.right + dx),
+		std::min(box.down, box.down + dz), std::max(box.up, box.up + dz));
+
+	int firstColumn = std::max((int)std::floor(swept.left - origin.x + 0.5f), 0);
+	int lastColumn = std::min((int)std::floor(swept.right - origin.x + 0.5f), columns - 1);
+	int firstRow = std::max((int)std::floor(swept.down - origin.z + 0.5f), 0);
+	int lastRow = std::min((int)std::floor(swept.up - origin.z + 0.5f), rows - 1);
+
+	bool hit = false;
+	time = 1.0f;
+	for (int i = firstRow; i <= lastRow; i++)
+	{
+		for (int j = firstColumn; j <= lastColumn; j++)
+		{
+			if (!cells[i * columns + j])
+				continue;
+
+			float t, nx, nz;
+			if (box.Sweep(CellBox(i, j), dx, dz, t, nx, nz) && t < time)
+			{
+				time = t;
+				normalX = nx;
+				normalZ = nz;
+				hit = true;
+			}
+		}
+	}
+	return hit;
+}
@@ -0,0 +1,90 @@
+#ifndef TILE_MAP_H
+#define TILE_MAP_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "Aabb.h"
+
+// Static walls of a grid map kept as cells instead of one Body per wall.
+// Wall cells are unit boxes centred on (column, row) + origin. A box only
+// visits the cells it covers, so the cost of a query does not depend on how
+// many walls the map has.
+class TileMap
+{
+public:
+	TileMap();
+	~TileMap();
+
+	void Load(const std::vector<std::vector<int>>& grid, glm::vec3 origin);
+
+	bool IsWall(int row, int column) const;
+	glm::vec3 CellPosition(int row, int column) const;
+	Aabb CellBox(int row, int column) const;
+
+	int Rows() const { return rows; }
+	int Columns() const { return columns; }
+	unsigned int WallCount() const { return wallCount; }
+	glm::vec3 Origin() const { return origin; }
+	// rows * columns flags, 1 for walls
+	const unsigned char* Cells() const { return cells.data(); }
+
+	// visit(const Aabb& wall, unsigned int cell) for every wall cell the box
+	// overlaps, cell is row * Columns() + column
+	template <typename Visit>
+	void ForEachWall(const Aabb& box, Visit visit) const
+	{
+		int firstColumn = std::max((int)std::floor(box.left - origin.x + 0.5f), 0);
+		int lastColumn = std::min((int)std::floor(box.right - origin.x + 0.5f), columns - 1);
+		int firstRow = std::max((int)std::floor(box.down - origin.z + 0.5f), 0);
+		int lastRow = std::min((int)std::floor(box.up - origin.z + 0.5f), rows - 1);
+
+		for (int i = firstRow; i <= lastRow; i++)
+		{
+			for (int j = firstColumn; j <= lastColumn; j++)
+			{
+				if (!cells[i * columns + j])
+					continue;
+
+				Aabb wall = CellBox(i, j);
+				if (box.Overlaps(wall))
+				{
+					visit(wall, (unsigned int)(i * columns + j));
+				}
+			}
+		}
+	}
+
+	// first wall cell the box hits when moved by (dx, dz), see Aabb::Sweep.
+	// Only the cells under the swept area are tested.
+	bool Sweep(const Aabb& box, float dx, float dz, float& time, float& normalX, float& normalZ) const;
+
+	// visit(glm::vec3 position) for every wall cell, for rendering
+	template <typename Visit>
+	void ForEachWall(Visit visit) const
+	{
+		for (int i = 0; i < rows; i++)
+		{
+			for (int j = 0; j < columns; j++)
+			{
+				if (cells[i * columns + j])
+				{
+					visit(CellPosition(i, j));
+				}
+			}
+		}
+	}
+
+private:
+	int rows = 0;
+	int columns = 0;
+	unsigned int wallCount = 0;
+	glm::vec3 origin;
+
+	std::vector<unsigned char> cells;
+};
+
+#endif // !TILE_MAP_H